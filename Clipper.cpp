@@ -0,0 +1,79 @@
+#include "pch.h"
+#include "Clipper.h"
+#include "Mesh.h"
+
+namespace dae
+{
+	namespace Rasterizer
+	{
+		//Signed distance to a plane, inside when >= 0
+		static float PlaneDistance(const Vector4& clipPos, uint32_t plane)
+		{
+			switch (plane)
+			{
+			case ClipNear:
+				return clipPos.z - NearEpsilon * clipPos.w;
+			case ClipLeft:
+				return clipPos.x + GuardBand * clipPos.w;
+			case ClipRight:
+				return GuardBand * clipPos.w - clipPos.x;
+			case ClipBottom:
+				return clipPos.y + GuardBand * clipPos.w;
+			default:
+				return GuardBand * clipPos.w - clipPos.y;
+			}
+		}
+
+		static Vertex_PosColOut LerpVertex(const Vertex_PosColOut& v0, const Vertex_PosColOut& v1, float t)
+		{
+			Vertex_PosColOut v{};
+			v.Pos = v0.Pos + (v1.Pos - v0.Pos) * t;
+			v.Color = v0.Color + (v1.Color - v0.Color) * t;
+			v.Uv = v0.Uv + (v1.Uv - v0.Uv) * t;
+			v.Normal = v0.Normal + (v1.Normal - v0.Normal) * t;
+			v.Tangent = v0.Tangent + (v1.Tangent - v0.Tangent) * t;
+			v.viewDirection = v0.viewDirection + (v1.viewDirection - v0.viewDirection) * t;
+			return v;
+		}
+
+		int ClipTriangle(const Vertex_PosColOut triangle[3], uint32_t planes, Vertex_PosColOut polygon[MaxClippedVertices])
+		{
+			//Sutherland-Hodgman, ping-pong between the output and a scratch polygon
+			Vertex_PosColOut scratch[MaxClippedVertices]{};
+			std::copy_n(triangle, 3, polygon);
+			int nrVertices{ 3 };
+
+			for (uint32_t plane{ ClipNear }; plane <= ClipTop; plane <<= 1)
+			{
+				if ((planes & plane) == 0)
+					continue;
+
+				std::copy_n(polygon, nrVertices, scratch);
+				int nrClipped{};
+
+				for (int i{}; i < nrVertices; ++i)
+				{
+					const Vertex_PosColOut& current{ scratch[i] };
+					const Vertex_PosColOut& next{ scratch[(i + 1) % nrVertices] };
+					const float currentDistance{ PlaneDistance(current.Pos, plane) };
+					const float nextDistance{ PlaneDistance(next.Pos, plane) };
+
+					if (currentDistance >= 0.f)
+					{
+						polygon[nrClipped++] = current;
+					}
+					if ((currentDistance >= 0.f) != (nextDistance >= 0.f))
+					{
+						polygon[nrClipped++] = LerpVertex(current, next, currentDistance / (currentDistance - nextDistance));
+					}
+				}
+
+				nrVertices = nrClipped;
+				if (nrVertices < 3)
+					return 0;
+			}
+
+			return nrVertices;
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include "Math.h"
+
+struct Vertex_PosColOut;
+
+namespace dae
+{
+	namespace Rasterizer
+	{
+		//Outcode bits, set when a clip space position lies outside the plane
+		enum ClipPlane : uint32_t
+		{
+			ClipNear = 1 << 0,
+			ClipLeft = 1 << 1,
+			ClipRight = 1 << 2,
+			ClipBottom = 1 << 3,
+			ClipTop = 1 << 4
+		};
+
+		//x and y are only clipped once a vertex is this many half viewports away from the center, everything inside
+		//the guard band is left to the bounding box and tile clipping of the rasterizer
+		constexpr float GuardBand{ 16.f };
+
+		//The near plane sits just in front of z = 0 so 1 / z stays finite for the depth interpolation
+		constexpr float NearEpsilon{ 1e-5f };
+
+		//Every plane adds at most one vertex to the polygon
+		constexpr int MaxClippedVertices{ 3 + 5 };
+
+		inline uint32_t GetClipCode(const Vector4& clipPos)
+		{
+			const float guardW{ GuardBand * clipPos.w };
+			uint32_t code{};
+			if (clipPos.z < NearEpsilon * clipPos.w || clipPos.w <= 0.f) code |= ClipNear;
+			if (clipPos.x < -guardW) code |= ClipLeft;
+			if (clipPos.x > guardW) code |= ClipRight;
+			if (clipPos.y < -guardW) code |= ClipBottom;
+			if (clipPos.y > guardW) code |= ClipTop;
+			return code;
+		}
+
+		/**
+		 * \brief Clips a triangle in homogeneous clip space, Pos holds x, y, z and w before the perspective divide
+		 * \param planes ClipPlane bits to clip against, usually the union of the vertex outcodes
+		 * \param polygon receives the clipped convex polygon, every attribute is interpolated linearly
+		 * \return number of polygon vertices, 0 when nothing is left
+		 */
+		int ClipTriangle(const Vertex_PosColOut triangle[3], uint32_t planes, Vertex_PosColOut polygon[MaxClippedVertices]);
+	}
+}
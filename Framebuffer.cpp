@@ -0,0 +1,137 @@
+#include "pch.h"
+#include "Framebuffer.h"
+#include "RasterizerSIMD.h"
+
+#include <immintrin.h>
+
+namespace dae
+{
+	namespace Rasterizer
+	{
+		static void ResolveScalar(const ColorRGB* pColors, uint32_t* pPixels, int nrPixels, const PixelFormat& format)
+		{
+			for (int i{}; i < nrPixels; ++i)
+			{
+				ColorRGB color{ pColors[i] };
+				color.MaxToOne();
+				pPixels[i] = PackPixel(format,
+					static_cast<uint8_t>(color.r * 255),
+					static_cast<uint8_t>(color.g * 255),
+					static_cast<uint8_t>(color.b * 255));
+			}
+		}
+
+		//Splits 4 interleaved rgb colors into one register per channel
+		static void LoadColors4(const ColorRGB* pColors, __m128& r, __m128& g, __m128& b)
+		{
+			const float* pFloats{ &pColors->r };
+			const __m128 a{ _mm_loadu_ps(pFloats) };     //r0 g0 b0 r1
+			const __m128 c{ _mm_loadu_ps(pFloats + 4) }; //g1 b1 r2 g2
+			const __m128 d{ _mm_loadu_ps(pFloats + 8) }; //b2 r3 g3 b3
+
+			const __m128 red{ _mm_blend_ps(_mm_blend_ps(a, c, 0b0100), d, 0b0010) };   //r0 r3 r2 r1
+			const __m128 green{ _mm_blend_ps(_mm_blend_ps(a, c, 0b1001), d, 0b0100) }; //g1 g0 g3 g2
+			const __m128 blue{ _mm_blend_ps(_mm_blend_ps(a, c, 0b0010), d, 0b1001) };  //b2 b1 b0 b3
+			r = _mm_shuffle_ps(red, red, _MM_SHUFFLE(1, 2, 3, 0));
+			g = _mm_shuffle_ps(green, green, _MM_SHUFFLE(2, 3, 0, 1));
+			b = _mm_shuffle_ps(blue, blue, _MM_SHUFFLE(3, 0, 1, 2));
+		}
+
+		static void ResolveSSE4(const ColorRGB* pColors, uint32_t* pPixels, int nrPixels, const PixelFormat& format)
+		{
+			const __m128 one{ _mm_set1_ps(1.f) };
+			const __m128 scale{ _mm_set1_ps(255.f) };
+			const __m128i redShift{ _mm_cvtsi32_si128(static_cast<int>(format.redShift)) };
+			const __m128i greenShift{ _mm_cvtsi32_si128(static_cast<int>(format.greenShift)) };
+			const __m128i blueShift{ _mm_cvtsi32_si128(static_cast<int>(format.blueShift)) };
+			const __m128i alpha{ _mm_set1_epi32(static_cast<int>(format.alphaMask)) };
+
+			int i{};
+			for (; i + 4 <= nrPixels; i += 4)
+			{
+				__m128 r{}, g{}, b{};
+				LoadColors4(pColors + i, r, g, b);
+
+				const __m128 maxValue{ _mm_max_ps(r, _mm_max_ps(g, b)) };
+				const __m128 divisor{ _mm_max_ps(maxValue, one) };
+				r = _mm_max_ps(_mm_mul_ps(_mm_div_ps(r, divisor), scale), _mm_setzero_ps());
+				g = _mm_max_ps(_mm_mul_ps(_mm_div_ps(g, divisor), scale), _mm_setzero_ps());
+				b = _mm_max_ps(_mm_mul_ps(_mm_div_ps(b, divisor), scale), _mm_setzero_ps());
+
+				__m128i pixels{ _mm_or_si128(alpha, _mm_sll_epi32(_mm_cvttps_epi32(r), redShift)) };
+				pixels = _mm_or_si128(pixels, _mm_sll_epi32(_mm_cvttps_epi32(g), greenShift));
+				pixels = _mm_or_si128(pixels, _mm_sll_epi32(_mm_cvttps_epi32(b), blueShift));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + i), pixels);
+			}
+
+			ResolveScalar(pColors + i, pPixels + i, nrPixels - i, format);
+		}
+
+		static void ResolveAVX2(const ColorRGB* pColors, uint32_t* pPixels, int nrPixels, const PixelFormat& format)
+		{
+			const __m256 one{ _mm256_set1_ps(1.f) };
+			const __m256 scale{ _mm256_set1_ps(255.f) };
+			const __m128i redShift{ _mm_cvtsi32_si128(static_cast<int>(format.redShift)) };
+			const __m128i greenShift{ _mm_cvtsi32_si128(static_cast<int>(format.greenShift)) };
+			const __m128i blueShift{ _mm_cvtsi32_si128(static_cast<int>(format.blueShift)) };
+			const __m256i alpha{ _mm256_set1_epi32(static_cast<int>(format.alphaMask)) };
+
+			int i{};
+			for (; i + 8 <= nrPixels; i += 8)
+			{
+				__m128 r0{}, g0{}, b0{}, r1{}, g1{}, b1{};
+				LoadColors4(pColors + i, r0, g0, b0);
+				LoadColors4(pColors + i + 4, r1, g1, b1);
+				__m256 r{ _mm256_set_m128(r1, r0) };
+				__m256 g{ _mm256_set_m128(g1, g0) };
+				__m256 b{ _mm256_set_m128(b1, b0) };
+
+				const __m256 maxValue{ _mm256_max_ps(r, _mm256_max_ps(g, b)) };
+				const __m256 divisor{ _mm256_max_ps(maxValue, one) };
+				r = _mm256_max_ps(_mm256_mul_ps(_mm256_div_ps(r, divisor), scale), _mm256_setzero_ps());
+				g = _mm256_max_ps(_mm256_mul_ps(_mm256_div_ps(g, divisor), scale), _mm256_setzero_ps());
+				b = _mm256_max_ps(_mm256_mul_ps(_mm256_div_ps(b, divisor), scale), _mm256_setzero_ps());
+
+				__m256i pixels{ _mm256_or_si256(alpha, _mm256_sll_epi32(_mm256_cvttps_epi32(r), redShift)) };
+				pixels = _mm256_or_si256(pixels, _mm256_sll_epi32(_mm256_cvttps_epi32(g), greenShift));
+				pixels = _mm256_or_si256(pixels, _mm256_sll_epi32(_mm256_cvttps_epi32(b), blueShift));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(pPixels + i), pixels);
+			}
+
+			ResolveSSE4(pColors + i, pPixels + i, nrPixels - i, format);
+		}
+
+		ResolveFunction GetResolveFunction()
+		{
+			static const ResolveFunction function{ HasAVX2() ? ResolveAVX2 : HasSSE4() ? ResolveSSE4 : ResolveScalar };
+			return function;
+		}
+
+		void StreamFill(uint32_t* pPixels, int nrPixels, uint32_t value)
+		{
+			int i{};
+
+			//Unaligned head and tail use 4 byte streaming stores, the rest 16 bytes at a time
+			for (; i < nrPixels && (reinterpret_cast<uintptr_t>(pPixels + i) & 15) != 0; ++i)
+			{
+				_mm_stream_si32(reinterpret_cast<int*>(pPixels + i), static_cast<int>(value));
+			}
+
+			const __m128i values{ _mm_set1_epi32(static_cast<int>(value)) };
+			for (; i + 4 <= nrPixels; i += 4)
+			{
+				_mm_stream_si128(reinterpret_cast<__m128i*>(pPixels + i), values);
+			}
+
+			for (; i < nrPixels; ++i)
+			{
+				_mm_stream_si32(reinterpret_cast<int*>(pPixels + i), static_cast<int>(value));
+			}
+		}
+
+		void StreamFence()
+		{
+			_mm_sfence();
+		}
+	}
+}
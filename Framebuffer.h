@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include "ColorRGB.h"
+
+namespace dae
+{
+	namespace Rasterizer
+	{
+		//Channel positions of a 32 bit pixel with 8 bits per channel, alpha (if any) is always written opaque
+		struct PixelFormat
+		{
+			uint32_t redShift{ 16 };
+			uint32_t greenShift{ 8 };
+			uint32_t blueShift{ 0 };
+			uint32_t alphaMask{ 0 };
+		};
+
+		inline uint32_t PackPixel(const PixelFormat& format, uint8_t r, uint8_t g, uint8_t b)
+		{
+			return (uint32_t(r) << format.redShift) | (uint32_t(g) << format.greenShift) | (uint32_t(b) << format.blueShift) | format.alphaMask;
+		}
+
+		/**
+		 * \brief Converts float colors to packed pixels, colors brighter than 1 are scaled down like ColorRGB::MaxToOne
+		 * \param pColors nrPixels colors
+		 * \param pPixels nrPixels packed pixels
+		 */
+		using ResolveFunction = void(*)(const ColorRGB* pColors, uint32_t* pPixels, int nrPixels, const PixelFormat& format);
+
+		//8 pixels at a time with AVX2 when the cpu and os support it, 4 with SSE4.1 otherwise
+		ResolveFunction GetResolveFunction();
+
+		//Fills nrPixels packed pixels with non-temporal stores, for memory that is not read again this frame
+		void StreamFill(uint32_t* pPixels, int nrPixels, uint32_t value);
+
+		//Orders the streaming stores before the writes that follow, call it before another thread reads the pixels
+		void StreamFence();
+	}
+}
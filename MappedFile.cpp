@@ -0,0 +1,48 @@
+#include "pch.h"
+#include "MappedFile.h"
+#include <Windows.h>
+
+namespace dae
+{
+	MappedFile::MappedFile(const std::string& path)
+	{
+		HANDLE file{ CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+		m_File = file;
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+			return;
+
+		//A mapping of an empty file fails, so those stay closed as well
+		m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!m_Mapping)
+			return;
+
+		m_pData = static_cast<const char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+		if (m_pData)
+		{
+			m_Size = static_cast<size_t>(size.QuadPart);
+		}
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (m_pData)
+		{
+			UnmapViewOfFile(m_pData);
+			m_pData = nullptr;
+		}
+		if (m_Mapping)
+		{
+			CloseHandle(m_Mapping);
+			m_Mapping = nullptr;
+		}
+		if (m_File)
+		{
+			CloseHandle(m_File);
+			m_File = nullptr;
+		}
+	}
+}
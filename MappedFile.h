@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+
+namespace dae
+{
+	/**
+	 * \brief Read only view of a whole file mapped into memory, pages are loaded by the os on first access
+	 * and shared with every other process mapping the same file
+	 */
+	class MappedFile final
+	{
+	public:
+		explicit MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		//false when the file is missing, empty or could not be mapped
+		bool IsOpen() const { return m_pData != nullptr; }
+		const char* GetData() const { return m_pData; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		void* m_File{ nullptr }; //HANDLE
+		void* m_Mapping{ nullptr }; //HANDLE
+		const char* m_pData{ nullptr };
+		size_t m_Size{};
+	};
+}
@@ -0,0 +1,72 @@
+#include "pch.h"
+#include "MaterialTexture.h"
+#include "Vector2.h"
+
+namespace dae
+{
+	MaterialTexture::MaterialTexture(Texture* pDiffuseGloss, Texture* pNormalSpecular) :
+		m_pDiffuseGloss{ pDiffuseGloss },
+		m_pNormalSpecular{ pNormalSpecular }
+	{
+	}
+
+	MaterialTexture::~MaterialTexture()
+	{
+		delete m_pDiffuseGloss;
+		m_pDiffuseGloss = nullptr;
+		delete m_pNormalSpecular;
+		m_pNormalSpecular = nullptr;
+	}
+
+	MaterialTexture* MaterialTexture::CreateFromTextures(const Texture* pDiffuse, const Texture* pNormal,
+		const Texture* pGloss, const Texture* pSpecular, TextureLayout layout)
+	{
+		const int width{ pDiffuse->GetWidth() };
+		const int height{ pDiffuse->GetHeight() };
+
+		//Nearest texel of a map at pixel (x, y) of the packed image
+		const auto getTexel{ [width, height](const Texture* pTexture, int x, int y)
+			{
+				return pTexture->GetPixel(x * pTexture->GetWidth() / width, y * pTexture->GetHeight() / height);
+			} };
+
+		//The red channel of the gloss and specular maps replaces the alpha of the others, r is the lowest byte
+		std::vector<uint32_t> diffuseGloss(static_cast<size_t>(width) * height);
+		std::vector<uint32_t> normalSpecular(static_cast<size_t>(width) * height);
+		for (int y{}; y < height; ++y)
+		{
+			for (int x{}; x < width; ++x)
+			{
+				const size_t pixel{ static_cast<size_t>(x) + static_cast<size_t>(y) * width };
+				diffuseGloss[pixel] = (getTexel(pDiffuse, x, y) & 0x00FFFFFF) | (getTexel(pGloss, x, y) << 24);
+				normalSpecular[pixel] = (getTexel(pNormal, x, y) & 0x00FFFFFF) | (getTexel(pSpecular, x, y) << 24);
+			}
+		}
+
+		//Software only, the hardware effect keeps binding the separate maps
+		const auto createTexture{ [&](std::vector<uint32_t>& pixels)
+			{
+				SDL_Surface* pSurface{ SDL_CreateRGBSurfaceWithFormatFrom(pixels.data(), width, height, 32, width * 4, SDL_PIXELFORMAT_RGBA32) };
+				Texture* pTexture{ Texture::CreateFromSurface(pSurface, nullptr, TextureStorage::RGBA8, layout) };
+				SDL_FreeSurface(pSurface);
+				return pTexture;
+			} };
+
+		return new MaterialTexture{ createTexture(diffuseGloss), createTexture(normalSpecular) };
+	}
+
+	MaterialSample MaterialTexture::Sample(const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, TextureFilter filter, int maxAnisotropy) const
+	{
+		//Both textures have the same size, so they share the footprint
+		const TextureFootprint footprint{ m_pDiffuseGloss->GetFootprint(uvDdx, uvDdy, filter, maxAnisotropy) };
+		const TexelRGBA diffuseGloss{ m_pDiffuseGloss->SampleRGBA(uv, footprint, filter) };
+		const TexelRGBA normalSpecular{ m_pNormalSpecular->SampleRGBA(uv, footprint, filter) };
+
+		MaterialSample sample{};
+		sample.diffuse = ColorRGB{ diffuseGloss.r, diffuseGloss.g, diffuseGloss.b };
+		sample.normal = Vector3{ 2.f * normalSpecular.r - 1.f, 2.f * normalSpecular.g - 1.f, 2.f * normalSpecular.b - 1.f };
+		sample.gloss = diffuseGloss.a;
+		sample.specular = normalSpecular.a;
+		return sample;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Texture.h"
+#include "Vector3.h"
+
+namespace dae
+{
+	//Every map of the material at one uv
+	struct MaterialSample
+	{
+		ColorRGB diffuse{};
+		Vector3 normal{}; //tangent space, [-1, 1]
+		float gloss{};
+		float specular{};
+	};
+
+	/**
+	 * \brief Diffuse, normal, gloss and specular maps packed at load into two RGBA textures for the software rasterizer
+	 * diffuse.rgb + gloss.r and normal.rgb + specular.r, so a shaded pixel does two fetches instead of four
+	 */
+	class MaterialTexture final
+	{
+	public:
+		~MaterialTexture();
+
+		MaterialTexture(const MaterialTexture&) = delete;
+		MaterialTexture(MaterialTexture&&) noexcept = delete;
+		MaterialTexture& operator=(const MaterialTexture&) = delete;
+		MaterialTexture& operator=(MaterialTexture&&) noexcept = delete;
+
+		//Packs the images of maps that are already loaded, maps of another size than the diffuse one are resampled to it
+		static MaterialTexture* CreateFromTextures(const Texture* pDiffuse, const Texture* pNormal,
+			const Texture* pGloss, const Texture* pSpecular, TextureLayout layout = TextureLayout::Linear);
+
+		MaterialSample Sample(const Vector2& uv, const Vector2& uvDdx, const Vector2& uvDdy, TextureFilter filter, int maxAnisotropy = 1) const;
+
+	private:
+		MaterialTexture(Texture* pDiffuseGloss, Texture* pNormalSpecular);
+
+		Texture* m_pDiffuseGloss{ nullptr };
+		Texture* m_pNormalSpecular{ nullptr };
+	};
+}
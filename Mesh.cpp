@@ -4,10 +4,28 @@
 #include <cassert>
 
 #include "Effect.h"
+#include "MeshAsset.h"
 
 Mesh::Mesh(ID3D11Device* pDevice,const std::vector<Vertex_PosCol>& vertices,std::vector<uint32_t> indices)
 {
-	
+	CreateBuffers(pDevice, vertices, indices);
+}
+
+Mesh::Mesh(ID3D11Device* pDevice, dae::Utils::MeshAsset* pAsset)
+	: m_pAsset{ pAsset }
+{
+	CreateBuffers(pDevice, m_pAsset->GetVertices(), m_pAsset->GetIndices());
+
+	//software
+	m_Indices = m_pAsset->GetIndices();
+	vertexStream.SetStream(m_pAsset->GetVertexStream(), static_cast<uint32_t>(m_pAsset->GetVertices().size()),
+		m_pAsset->GetVertexFormat(), m_pAsset->GetQuantization());
+	vertices_out.resize(vertexStream.GetNrVertices());
+	clipPositions_out.resize(vertexStream.GetNrVertices());
+}
+
+void Mesh::CreateBuffers(ID3D11Device* pDevice, std::span<const Vertex_PosCol> vertices, std::span<const uint32_t> indices)
+{
 	m_pEffect = new Effect(pDevice, L"Resources/PosCol3D.fx");
 	m_pTechnique = m_pEffect->GetTechnique();
 	//create Vertex Layout
@@ -97,6 +115,9 @@ Mesh::~Mesh()
 		delete m_pEffect;
 		m_pEffect = nullptr;
 	}
+
+	delete m_pAsset;
+	m_pAsset = nullptr;
 }
 
 void Mesh::Render(ID3D11DeviceContext* pDeviceContext)
@@ -128,11 +149,15 @@ void Mesh::Render(ID3D11DeviceContext* pDeviceContext)
 void Mesh::SetVertices(const std::vector<Vertex_PosCol>& vertices)
 {
 	m_Vertices = vertices;
+	vertexStream.SetVertices(m_Vertices);
+	vertices_out.resize(m_Vertices.size());
+	clipPositions_out.resize(m_Vertices.size());
 }
 
 void Mesh::SetIndices(const std::vector<uint32_t>& indices)
 {
-	m_Indices = indices;
+	m_IndexStorage = indices;
+	m_Indices = m_IndexStorage;
 }
 
 
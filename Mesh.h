@@ -1,7 +1,9 @@
 #pragma once
-
+#include <span>
+#include "VertexStream.h"
 
 class Effect;
+namespace dae { namespace Utils { class MeshAsset; } }
 
 enum class Technique {
     Point,
@@ -44,6 +46,8 @@ class Mesh
 public:
 
     Mesh(ID3D11Device* pDevice,const std::vector<Vertex_PosCol>& vertices, std::vector<uint32_t> indices);
+    //Owns pAsset, the buffers are filled and the software indices and vertex stream point straight into it
+    Mesh(ID3D11Device* pDevice, dae::Utils::MeshAsset* pAsset);
     ~Mesh();
 
     void SetMatrix(const dae::Matrix* matrix, const dae::Matrix* worldMatrix, const dae::Matrix* cameraPos);
@@ -57,8 +61,15 @@ public:
 
     //software
     std::vector<Vertex_PosCol> m_Vertices{};
-    std::vector<uint32_t> m_Indices{};
+    dae::Rasterizer::VertexStream vertexStream{}; //m_Vertices as separate arrays for the batched vertex stage
+    std::span<const uint32_t> m_Indices{}; //m_IndexStorage, or the indices of the asset
+    std::vector<Vertex_PosColOut> vertices_out{}; //m_Vertices after the vertex stage, rewritten every frame
+    std::vector<Vector4> clipPositions_out{}; //positions of vertices_out before the perspective divide, for the clipper
 private:
+    void CreateBuffers(ID3D11Device* pDevice, std::span<const Vertex_PosCol> vertices, std::span<const uint32_t> indices);
+
+    dae::Utils::MeshAsset* m_pAsset{ nullptr };
+    std::vector<uint32_t> m_IndexStorage{};
     ID3DX11EffectTechnique* m_pTechnique{ nullptr };
     ID3D11InputLayout* m_pInputLayout{ nullptr };
     ID3D11Buffer* m_pVertexBuffer{ nullptr };
@@ -66,8 +77,5 @@ private:
     int m_NumInd{ 0 };
 
     PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleStrip };
-
-    std::vector<Vertex_PosColOut> vertices_out{};
-  
 };
 
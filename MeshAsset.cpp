@@ -0,0 +1,273 @@
+#include "pch.h"
+#include "MeshAsset.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "Utils.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+
+namespace dae
+{
+	namespace Utils
+	{
+		static constexpr char MeshMagic[4]{ 'D', 'M', 'S', 'H' };
+		//Bump whenever the layout or the processing of the cache changes, older caches are then rebuilt
+		static constexpr uint32_t MeshVersion{ 2 };
+		//Blobs start on a cache line, which also covers the 32 bytes the vertex stream loads need
+		static constexpr size_t BlobAlignment{ 64 };
+		static constexpr std::align_val_t OwnedDataAlignment{ BlobAlignment };
+
+		struct MeshHeader
+		{
+			char magic[4]{};
+			uint32_t version{};
+			uint32_t vertexSize{}; //sizeof(Vertex_PosCol) of the writer
+			MeshOrder order{};
+			Rasterizer::VertexFormat format{};
+			//The OBJ the cache was made from
+			uint64_t sourceSize{};
+			int64_t sourceTime{};
+
+			uint32_t nrVertices{};
+			uint32_t nrIndices{};
+			uint32_t nrLods{};
+			Vector3 boundsMin{};
+			Vector3 boundsMax{};
+			Rasterizer::VertexQuantization quantization{};
+
+			//Byte offsets from the start of the file
+			uint64_t verticesOffset{};
+			uint64_t streamOffset{};
+			uint64_t indicesOffset{};
+			uint64_t lodsOffset{};
+			uint64_t fileSize{};
+		};
+
+		static uint64_t AlignBlob(uint64_t offset)
+		{
+			return (offset + BlobAlignment - 1) / BlobAlignment * BlobAlignment;
+		}
+
+		//Compares against what is left after the offset, so a garbage offset or count cannot wrap around
+		static bool IsValidBlob(uint64_t offset, uint64_t count, uint64_t elementSize, size_t size)
+		{
+			return offset % BlobAlignment == 0 && offset <= size && count <= (size - offset) / elementSize;
+		}
+
+		static bool IsValidCache(const char* pData, size_t size, bool hasSource, uint64_t sourceSize, int64_t sourceTime, MeshOrder order, Rasterizer::VertexFormat format)
+		{
+			if (size < sizeof(MeshHeader))
+				return false;
+
+			const MeshHeader& header{ *reinterpret_cast<const MeshHeader*>(pData) };
+			if (std::memcmp(header.magic, MeshMagic, sizeof(MeshMagic)) != 0 || header.version != MeshVersion
+				|| header.vertexSize != sizeof(Vertex_PosCol) || header.order != order
+				|| header.format != format || header.fileSize != size)
+				return false;
+
+			//A missing OBJ keeps whatever cache there is, so the caches can be shipped on their own
+			if (hasSource && (header.sourceSize != sourceSize || header.sourceTime != sourceTime))
+				return false;
+
+			//The offsets of a file with the right size can still be garbage
+			if (header.nrLods == 0
+				|| !IsValidBlob(header.verticesOffset, header.nrVertices, sizeof(Vertex_PosCol), size)
+				|| !IsValidBlob(header.streamOffset, Rasterizer::VertexStream::GetStreamSize(header.nrVertices, format), 1, size)
+				|| !IsValidBlob(header.indicesOffset, header.nrIndices, sizeof(uint32_t), size)
+				|| !IsValidBlob(header.lodsOffset, header.nrLods, sizeof(MeshLod), size))
+				return false;
+
+			const MeshLod* pLods{ reinterpret_cast<const MeshLod*>(pData + header.lodsOffset) };
+			for (uint32_t lod{}; lod < header.nrLods; ++lod)
+			{
+				if (pLods[lod].firstIndex > header.nrIndices || pLods[lod].nrIndices > header.nrIndices - pLods[lod].firstIndex)
+					return false;
+			}
+
+			//Checked once here, so the rasterizers can index the vertices without bounds checks
+			const uint32_t* pIndices{ reinterpret_cast<const uint32_t*>(pData + header.indicesOffset) };
+			return std::all_of(pIndices, pIndices + header.nrIndices, [&header](uint32_t index) { return index < header.nrVertices; });
+		}
+
+		/**
+		 * \brief Lays the mesh out the way the cache file stores it, the returned memory is BlobAlignment aligned
+		 * \param size receives the size of the cache
+		 */
+		static char* BuildCache(const std::vector<Vertex_PosCol>& vertices, const std::vector<uint32_t>& indices, const std::vector<MeshLod>& lods,
+			uint64_t sourceSize, int64_t sourceTime, MeshOrder order, Rasterizer::VertexFormat format, size_t& size)
+		{
+			MeshHeader header{};
+			std::memcpy(header.magic, MeshMagic, sizeof(MeshMagic));
+			header.version = MeshVersion;
+			header.vertexSize = sizeof(Vertex_PosCol);
+			header.order = order;
+			header.format = format;
+			header.sourceSize = sourceSize;
+			header.sourceTime = sourceTime;
+			header.nrVertices = static_cast<uint32_t>(vertices.size());
+			header.nrIndices = static_cast<uint32_t>(indices.size());
+			header.nrLods = static_cast<uint32_t>(lods.size());
+
+			if (!vertices.empty())
+			{
+				header.boundsMin = header.boundsMax = vertices.front().Pos;
+			}
+			for (const Vertex_PosCol& vertex : vertices)
+			{
+				for (int axis{}; axis < 3; ++axis)
+				{
+					header.boundsMin[axis] = std::min(header.boundsMin[axis], vertex.Pos[axis]);
+					header.boundsMax[axis] = std::max(header.boundsMax[axis], vertex.Pos[axis]);
+				}
+			}
+
+			if (format == Rasterizer::VertexFormat::Compact)
+			{
+				header.quantization = Rasterizer::VertexStream::GetQuantization(vertices);
+			}
+
+			const uint64_t streamSize{ Rasterizer::VertexStream::GetStreamSize(header.nrVertices, format) };
+			header.verticesOffset = AlignBlob(sizeof(MeshHeader));
+			header.streamOffset = AlignBlob(header.verticesOffset + vertices.size() * sizeof(Vertex_PosCol));
+			header.indicesOffset = AlignBlob(header.streamOffset + streamSize);
+			header.lodsOffset = AlignBlob(header.indicesOffset + indices.size() * sizeof(uint32_t));
+			header.fileSize = header.lodsOffset + lods.size() * sizeof(MeshLod);
+
+			size = static_cast<size_t>(header.fileSize);
+			char* pData{ static_cast<char*>(::operator new[](size, OwnedDataAlignment)) };
+			std::fill_n(pData, size, char{});
+			std::memcpy(pData, &header, sizeof(MeshHeader));
+			std::memcpy(pData + header.verticesOffset, vertices.data(), vertices.size() * sizeof(Vertex_PosCol));
+			Rasterizer::VertexStream::WriteStream(vertices, format, header.quantization, pData + header.streamOffset);
+			std::memcpy(pData + header.indicesOffset, indices.data(), indices.size() * sizeof(uint32_t));
+			std::memcpy(pData + header.lodsOffset, lods.data(), lods.size() * sizeof(MeshLod));
+			return pData;
+		}
+
+		//Written next to the cache and renamed over it, so another process never maps half a file
+		static void WriteCache(const std::string& cachePath, const char* pData, size_t size)
+		{
+			const std::string tempPath{ cachePath + ".tmp" };
+			{
+				std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+				if (!file.write(pData, static_cast<std::streamsize>(size)))
+					return;
+			}
+
+			std::error_code error{};
+			std::filesystem::rename(tempPath, cachePath, error);
+			if (error)
+			{
+				std::filesystem::remove(tempPath, error);
+			}
+		}
+
+		MeshAsset* MeshAsset::Load(const std::string& objPath, MeshOrder order, Rasterizer::VertexFormat format)
+		{
+			const std::string cachePath{ objPath + ".mesh" };
+
+			std::error_code error{};
+			const uint64_t sourceSize{ std::filesystem::file_size(objPath, error) };
+			const bool hasSource{ !error };
+			const int64_t sourceTime{ hasSource ? static_cast<int64_t>(std::filesystem::last_write_time(objPath, error).time_since_epoch().count()) : 0 };
+
+			MappedFile* pFile{ new MappedFile{ cachePath } };
+			if (pFile->IsOpen() && IsValidCache(pFile->GetData(), pFile->GetSize(), hasSource, sourceSize, sourceTime, order, format))
+				return new MeshAsset{ pFile, nullptr };
+			delete pFile;
+
+			std::vector<Vertex_PosCol> vertices{};
+			std::vector<uint32_t> indices{};
+			if (!hasSource || !ParseOBJ(objPath, vertices, indices))
+				return nullptr;
+
+			for (Vertex_PosCol& vertex : vertices)
+			{
+				vertex.Color = { 1, 1, 1 };
+			}
+
+			switch (order)
+			{
+			case MeshOrder::VertexCacheAndOverdraw:
+				OptimizeMesh(vertices, indices);
+				break;
+			case MeshOrder::VertexFetch:
+				OptimizeVertexFetch(vertices, indices);
+				break;
+			}
+
+			//Only the full mesh for now, lower levels go behind it in the index blob
+			const std::vector<MeshLod> lods{ MeshLod{ 0, static_cast<uint32_t>(indices.size()) } };
+
+			size_t size{};
+			char* pData{ BuildCache(vertices, indices, lods, sourceSize, sourceTime, order, format, size) };
+			WriteCache(cachePath, pData, size);
+
+			//The data is already in memory, mapping the new file would only load it again
+			return new MeshAsset{ nullptr, pData };
+		}
+
+		MeshAsset::MeshAsset(MappedFile* pFile, char* pOwnedData)
+			: m_pFile{ pFile }
+			, m_pOwnedData{ pOwnedData }
+			, m_pData{ pFile ? pFile->GetData() : pOwnedData }
+		{
+		}
+
+		MeshAsset::~MeshAsset()
+		{
+			delete m_pFile;
+			m_pFile = nullptr;
+			::operator delete[](m_pOwnedData, OwnedDataAlignment);
+			m_pOwnedData = nullptr;
+		}
+
+		std::span<const Vertex_PosCol> MeshAsset::GetVertices() const
+		{
+			const MeshHeader& header{ *reinterpret_cast<const MeshHeader*>(m_pData) };
+			return { reinterpret_cast<const Vertex_PosCol*>(m_pData + header.verticesOffset), header.nrVertices };
+		}
+
+		const void* MeshAsset::GetVertexStream() const
+		{
+			const MeshHeader& header{ *reinterpret_cast<const MeshHeader*>(m_pData) };
+			return m_pData + header.streamOffset;
+		}
+
+		Rasterizer::VertexFormat MeshAsset::GetVertexFormat() const
+		{
+			return reinterpret_cast<const MeshHeader*>(m_pData)->format;
+		}
+
+		const Rasterizer::VertexQuantization& MeshAsset::GetQuantization() const
+		{
+			return reinterpret_cast<const MeshHeader*>(m_pData)->quantization;
+		}
+
+		std::span<const uint32_t> MeshAsset::GetIndices(uint32_t lod) const
+		{
+			const MeshHeader& header{ *reinterpret_cast<const MeshHeader*>(m_pData) };
+			//The ranges were checked against the index blob at load
+			const MeshLod& range{ reinterpret_cast<const MeshLod*>(m_pData + header.lodsOffset)[std::min(lod, header.nrLods - 1)] };
+			return { reinterpret_cast<const uint32_t*>(m_pData + header.indicesOffset) + range.firstIndex, range.nrIndices };
+		}
+
+		uint32_t MeshAsset::GetNrLods() const
+		{
+			return reinterpret_cast<const MeshHeader*>(m_pData)->nrLods;
+		}
+
+		Vector3 MeshAsset::GetBoundsMin() const
+		{
+			return reinterpret_cast<const MeshHeader*>(m_pData)->boundsMin;
+		}
+
+		Vector3 MeshAsset::GetBoundsMax() const
+		{
+			return reinterpret_cast<const MeshHeader*>(m_pData)->boundsMax;
+		}
+	}
+}
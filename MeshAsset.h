@@ -0,0 +1,68 @@
+#pragma once
+#include <span>
+#include <string>
+#include "Mesh.h"
+
+namespace dae
+{
+	class MappedFile;
+
+	namespace Utils
+	{
+		//Which MeshOptimizer passes the indices went through, part of the cache so a change rebuilds it
+		enum class MeshOrder : uint32_t
+		{
+			VertexCacheAndOverdraw,
+			VertexFetch //only the vertices are renumbered, the triangles keep the order of the file for blended meshes
+		};
+
+		//Range of the index blob drawn at one level of detail, level 0 is the full mesh
+		struct MeshLod
+		{
+			uint32_t firstIndex{};
+			uint32_t nrIndices{};
+		};
+
+		/**
+		 * \brief An OBJ mesh loaded through its binary cache next to it (path + ".mesh"). The cache holds the welded, optimised
+		 * vertices, their VertexStream in one format, the indices, the bounds and the LOD ranges, so later loads only map it.
+		 * Every getter points straight into the mapping, which the os shares with every other process using the same cache
+		 */
+		class MeshAsset final
+		{
+		public:
+			/**
+			 * \brief Maps the cache of objPath, or parses the OBJ and writes the cache when it is missing,
+			 * from an older version, or older than the OBJ
+			 * \return nullptr when there is neither a valid cache nor a parsable OBJ
+			 */
+			static MeshAsset* Load(const std::string& objPath, MeshOrder order, Rasterizer::VertexFormat format = Rasterizer::VertexFormat::Float);
+			~MeshAsset();
+
+			MeshAsset(const MeshAsset&) = delete;
+			MeshAsset(MeshAsset&&) noexcept = delete;
+			MeshAsset& operator=(const MeshAsset&) = delete;
+			MeshAsset& operator=(MeshAsset&&) noexcept = delete;
+
+			std::span<const Vertex_PosCol> GetVertices() const;
+			//The vertices in the VertexStream layout of GetVertexFormat, for VertexStream::SetStream
+			const void* GetVertexStream() const;
+			Rasterizer::VertexFormat GetVertexFormat() const;
+			const Rasterizer::VertexQuantization& GetQuantization() const;
+			std::span<const uint32_t> GetIndices(uint32_t lod = 0) const;
+			uint32_t GetNrLods() const;
+			Vector3 GetBoundsMin() const;
+			Vector3 GetBoundsMax() const;
+
+			//false on the load that (re)built the cache, the asset then lives in memory
+			bool IsMapped() const { return m_pFile != nullptr; }
+
+		private:
+			MeshAsset(MappedFile* pFile, char* pOwnedData);
+
+			MappedFile* m_pFile{ nullptr };
+			char* m_pOwnedData{ nullptr };
+			const char* m_pData{ nullptr }; //the cache contents, in m_pFile or m_pOwnedData
+		};
+	}
+}
@@ -0,0 +1,329 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+#include <numeric>
+
+namespace dae
+{
+	namespace Utils
+	{
+		//Cache modelled by the vertex cache optimisation
+		static constexpr int ForsythCacheSize{ 32 };
+		//FIFO cache of the overdraw clustering, close to the post transform cache of real hardware
+		static constexpr int FifoCacheSize{ 16 };
+		static constexpr uint32_t InvalidIndex{ 0xFFFFFFFFu };
+
+		//Vertices of the last triangle score the same, the rest drop with their age and rise when few triangles still use them
+		static float GetVertexScore(int cachePosition, uint32_t nrRemainingTriangles)
+		{
+			if (nrRemainingTriangles == 0)
+				return -1.f;
+
+			float score{};
+			if (cachePosition >= 0)
+			{
+				score = cachePosition < 3 ?
+					0.75f :
+					std::pow(1.f - static_cast<float>(cachePosition - 3) / static_cast<float>(ForsythCacheSize - 3), 1.5f);
+			}
+			return score + 2.f / std::sqrt(static_cast<float>(nrRemainingTriangles));
+		}
+
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t nrVertices)
+		{
+			const size_t nrTriangles{ indices.size() / 3 };
+			if (nrTriangles == 0)
+				return;
+
+			//Triangles of every vertex, the first nrRemaining of each list are the ones not emitted yet
+			std::vector<uint32_t> nrRemaining(nrVertices);
+			for (uint32_t index : indices)
+			{
+				++nrRemaining[index];
+			}
+			std::vector<uint32_t> firstTriangle(nrVertices + 1);
+			std::partial_sum(nrRemaining.begin(), nrRemaining.end(), firstTriangle.begin() + 1);
+			std::vector<uint32_t> vertexTriangles(indices.size());
+			{
+				std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+				for (size_t i{}; i < indices.size(); ++i)
+				{
+					vertexTriangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+				}
+			}
+
+			std::vector<int> cachePositions(nrVertices, -1);
+			std::vector<float> vertexScores(nrVertices);
+			for (size_t v{}; v < nrVertices; ++v)
+			{
+				vertexScores[v] = GetVertexScore(-1, nrRemaining[v]);
+			}
+
+			const auto getTriangleScore{ [&](uint32_t triangle)
+				{
+					return vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] + vertexScores[indices[triangle * 3 + 2]];
+				} };
+
+			std::vector<char> isEmitted(nrTriangles);
+			uint32_t best{};
+			float bestScore{ getTriangleScore(0) };
+			for (uint32_t t{ 1 }; t < nrTriangles; ++t)
+			{
+				const float score{ getTriangleScore(t) };
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = t;
+				}
+			}
+
+			std::vector<uint32_t> output{};
+			output.reserve(indices.size());
+			std::vector<uint32_t> cache{};
+			std::vector<uint32_t> newCache{};
+			cache.reserve(ForsythCacheSize + 3);
+			newCache.reserve(ForsythCacheSize + 3);
+			size_t nextUnemitted{};
+
+			while (output.size() < indices.size())
+			{
+				//Dead end, no cached vertex has triangles left, continue in input order
+				if (best == InvalidIndex)
+				{
+					while (isEmitted[nextUnemitted])
+					{
+						++nextUnemitted;
+					}
+					best = static_cast<uint32_t>(nextUnemitted);
+				}
+
+				isEmitted[best] = 1;
+				const uint32_t* pTriangle{ &indices[best * 3] };
+				output.insert(output.end(), pTriangle, pTriangle + 3);
+
+				//The emitted triangle no longer counts for its vertices
+				for (int i{}; i < 3; ++i)
+				{
+					const uint32_t vertex{ pTriangle[i] };
+					uint32_t* pTriangles{ &vertexTriangles[firstTriangle[vertex]] };
+					uint32_t* pLast{ pTriangles + --nrRemaining[vertex] };
+					std::iter_swap(std::find(pTriangles, pLast, best), pLast);
+				}
+
+				//The triangle's vertices move to the front of the LRU cache
+				newCache.assign(pTriangle, pTriangle + 3);
+				for (uint32_t vertex : cache)
+				{
+					if (vertex != pTriangle[0] && vertex != pTriangle[1] && vertex != pTriangle[2])
+					{
+						newCache.push_back(vertex);
+					}
+				}
+				for (size_t i{}; i < newCache.size(); ++i)
+				{
+					const uint32_t vertex{ newCache[i] };
+					cachePositions[vertex] = i < ForsythCacheSize ? static_cast<int>(i) : -1;
+					vertexScores[vertex] = GetVertexScore(cachePositions[vertex], nrRemaining[vertex]);
+				}
+
+				//Only triangles of cached or just evicted vertices changed score
+				best = InvalidIndex;
+				bestScore = -FLT_MAX;
+				for (uint32_t vertex : newCache)
+				{
+					for (uint32_t i{ firstTriangle[vertex] }, end{ firstTriangle[vertex] + nrRemaining[vertex] }; i < end; ++i)
+					{
+						const uint32_t triangle{ vertexTriangles[i] };
+						const float score{ getTriangleScore(triangle) };
+						if (score > bestScore)
+						{
+							bestScore = score;
+							best = triangle;
+						}
+					}
+				}
+
+				if (newCache.size() > ForsythCacheSize)
+				{
+					newCache.resize(ForsythCacheSize);
+				}
+				std::swap(cache, newCache);
+			}
+
+			indices = std::move(output);
+		}
+
+		//FIFO post transform cache, a vertex is cached while fewer than FifoCacheSize misses happened after its own
+		class FifoCache final
+		{
+		public:
+			explicit FifoCache(size_t nrVertices)
+				: m_MissTimes(nrVertices)
+			{
+			}
+
+			//Everything loaded so far counts as evicted
+			void Clear()
+			{
+				m_Time += FifoCacheSize + 1;
+			}
+
+			uint32_t GetTriangleMisses(const uint32_t* pTriangle)
+			{
+				uint32_t nrMisses{};
+				for (int i{}; i < 3; ++i)
+				{
+					uint32_t& missTime{ m_MissTimes[pTriangle[i]] };
+					if (missTime == 0 || m_Time - missTime >= FifoCacheSize)
+					{
+						missTime = ++m_Time;
+						++nrMisses;
+					}
+				}
+				return nrMisses;
+			}
+
+		private:
+			std::vector<uint32_t> m_MissTimes;
+			uint32_t m_Time{};
+		};
+
+		void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex_PosCol>& vertices, float threshold)
+		{
+			const size_t nrTriangles{ indices.size() / 3 };
+			if (nrTriangles == 0)
+				return;
+
+			FifoCache cache{ vertices.size() };
+
+			//Hard boundaries, triangles that miss all their vertices start on a cold cache anyway
+			std::vector<size_t> hardClusters{};
+			for (size_t t{}; t < nrTriangles; ++t)
+			{
+				if (cache.GetTriangleMisses(&indices[t * 3]) == 3)
+				{
+					hardClusters.push_back(t);
+				}
+			}
+			hardClusters.push_back(nrTriangles);
+
+			//Soft boundaries, a cluster is split as soon as its misses per triangle so far are within threshold of the whole cluster's
+			std::vector<size_t> clusters{};
+			for (size_t c{}; c + 1 < hardClusters.size(); ++c)
+			{
+				const size_t first{ hardClusters[c] };
+				const size_t last{ hardClusters[c + 1] };
+
+				cache.Clear();
+				uint32_t clusterMisses{};
+				for (size_t t{ first }; t < last; ++t)
+				{
+					clusterMisses += cache.GetTriangleMisses(&indices[t * 3]);
+				}
+				const float maxMissesPerTriangle{ threshold * static_cast<float>(clusterMisses) / static_cast<float>(last - first) };
+
+				size_t t{ first };
+				while (t < last)
+				{
+					clusters.push_back(t);
+					cache.Clear();
+					const size_t start{ t };
+					uint32_t nrMisses{};
+					while (t < last)
+					{
+						nrMisses += cache.GetTriangleMisses(&indices[t * 3]);
+						++t;
+						if (static_cast<float>(nrMisses) <= maxMissesPerTriangle * static_cast<float>(t - start))
+							break;
+					}
+				}
+			}
+			clusters.push_back(nrTriangles);
+
+			//Center of the mesh weighted by triangle area
+			const auto getTriangle{ [&](size_t t, Vector3& centroid, Vector3& normal)
+				{
+					const Vertex_PosCol& v0{ vertices[indices[t * 3]] };
+					const Vertex_PosCol& v1{ vertices[indices[t * 3 + 1]] };
+					const Vertex_PosCol& v2{ vertices[indices[t * 3 + 2]] };
+					const float area{ Vector3::Cross(v1.Pos - v0.Pos, v2.Pos - v0.Pos).Magnitude() };
+					centroid = (v0.Pos + v1.Pos + v2.Pos) * (area / 3.f);
+					normal = (v0.Normal + v1.Normal + v2.Normal) * area;
+					return area;
+				} };
+
+			Vector3 meshCentroid{};
+			float meshArea{};
+			for (size_t t{}; t < nrTriangles; ++t)
+			{
+				Vector3 centroid{};
+				Vector3 normal{};
+				meshArea += getTriangle(t, centroid, normal);
+				meshCentroid += centroid;
+			}
+			if (meshArea > 0.f)
+			{
+				meshCentroid /= meshArea;
+			}
+
+			//How far out a cluster lies along its own normal, outer clusters occlude the inner ones
+			const size_t nrClusters{ clusters.size() - 1 };
+			std::vector<float> sortKeys(nrClusters);
+			for (size_t c{}; c < nrClusters; ++c)
+			{
+				Vector3 clusterCentroid{};
+				Vector3 clusterNormal{};
+				float clusterArea{};
+				for (size_t t{ clusters[c] }; t < clusters[c + 1]; ++t)
+				{
+					Vector3 centroid{};
+					Vector3 normal{};
+					clusterArea += getTriangle(t, centroid, normal);
+					clusterCentroid += centroid;
+					clusterNormal += normal;
+				}
+				if (clusterArea > 0.f)
+				{
+					clusterCentroid /= clusterArea;
+				}
+				const float normalLength{ clusterNormal.Magnitude() };
+				sortKeys[c] = normalLength > 0.f ? Vector3::Dot(clusterCentroid - meshCentroid, clusterNormal) / normalLength : 0.f;
+			}
+
+			std::vector<size_t> order(nrClusters);
+			std::iota(order.begin(), order.end(), size_t{});
+			std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+			std::vector<uint32_t> output{};
+			output.reserve(indices.size());
+			for (size_t c : order)
+			{
+				output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+			}
+			indices = std::move(output);
+		}
+
+		void OptimizeVertexFetch(std::vector<Vertex_PosCol>& vertices, std::vector<uint32_t>& indices)
+		{
+			std::vector<uint32_t> remap(vertices.size(), InvalidIndex);
+			std::vector<Vertex_PosCol> output{};
+			output.reserve(vertices.size());
+			for (uint32_t& index : indices)
+			{
+				if (remap[index] == InvalidIndex)
+				{
+					remap[index] = static_cast<uint32_t>(output.size());
+					output.push_back(vertices[index]);
+				}
+				index = remap[index];
+			}
+			vertices = std::move(output);
+		}
+
+		void OptimizeMesh(std::vector<Vertex_PosCol>& vertices, std::vector<uint32_t>& indices)
+		{
+			OptimizeVertexCache(indices, vertices.size());
+			OptimizeOverdraw(indices, vertices);
+			OptimizeVertexFetch(vertices, indices);
+		}
+	}
+}
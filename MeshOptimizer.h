@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+#include "Mesh.h"
+
+namespace dae
+{
+	namespace Utils
+	{
+		/**
+		 * \brief Reorders the triangles for the post transform vertex cache, then for overdraw, and renumbers the vertices
+		 * in the order they are first used. The winding of every triangle is kept
+		 */
+		void OptimizeMesh(std::vector<Vertex_PosCol>& vertices, std::vector<uint32_t>& indices);
+
+		//Forsyth's linear speed vertex cache optimisation, triangles whose vertices are still cached come first
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t nrVertices);
+
+		/**
+		 * \brief Splits the triangle order into clusters that each start on a cold cache and draws the clusters
+		 * facing away from the center of the mesh first, they are the most likely to hide the others
+		 * \param threshold clusters are only split where it costs at most this factor of their vertex cache misses
+		 */
+		void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex_PosCol>& vertices, float threshold = 1.05f);
+
+		//Vertices in the order of their first use by the indices, unused vertices are dropped
+		void OptimizeVertexFetch(std::vector<Vertex_PosCol>& vertices, std::vector<uint32_t>& indices);
+	}
+}
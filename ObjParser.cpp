@@ -0,0 +1,313 @@
+#include "pch.h"
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include <charconv>
+#include <cstring>
+
+namespace dae
+{
+	namespace Utils
+	{
+		//Below this per thread a file is parsed on fewer threads, starting them costs more than it saves
+		static constexpr size_t MinChunkSize{ 1 << 20 };
+
+		//Number of elements a chunk of the file adds to every array of ObjData
+		struct ObjCounts
+		{
+			size_t positions{};
+			size_t uvs{};
+			size_t normals{};
+			size_t triangles{};
+		};
+
+		enum class ObjLine
+		{
+			Other,
+			Position,
+			Uv,
+			Normal,
+			Face
+		};
+
+		//'\r' counts as a space so CRLF files need no special case
+		static bool IsSpace(char c)
+		{
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		static const char* SkipSpaces(const char* p, const char* pEnd)
+		{
+			while (p != pEnd && IsSpace(*p))
+			{
+				++p;
+			}
+			return p;
+		}
+
+		static const char* FindLineEnd(const char* p, const char* pEnd)
+		{
+			const void* pNewLine{ std::memchr(p, '\n', static_cast<size_t>(pEnd - p)) };
+			return pNewLine ? static_cast<const char*>(pNewLine) : pEnd;
+		}
+
+		//Kind of the line starting at p, p is moved past the keyword
+		static ObjLine ReadKeyword(const char*& p, const char* pEnd)
+		{
+			p = SkipSpaces(p, pEnd);
+			const ptrdiff_t length{ pEnd - p };
+			if (length >= 2 && p[0] == 'v' && IsSpace(p[1]))
+			{
+				p += 1;
+				return ObjLine::Position;
+			}
+			if (length >= 3 && p[0] == 'v' && p[1] == 't' && IsSpace(p[2]))
+			{
+				p += 2;
+				return ObjLine::Uv;
+			}
+			if (length >= 3 && p[0] == 'v' && p[1] == 'n' && IsSpace(p[2]))
+			{
+				p += 2;
+				return ObjLine::Normal;
+			}
+			if (length >= 2 && p[0] == 'f' && IsSpace(p[1]))
+			{
+				p += 1;
+				return ObjLine::Face;
+			}
+			return ObjLine::Other;
+		}
+
+		template<typename T>
+		static bool ReadNumber(const char*& p, const char* pEnd, T& value)
+		{
+			//from_chars does not take a leading '+'
+			if (p != pEnd && *p == '+')
+			{
+				++p;
+			}
+			const std::from_chars_result result{ std::from_chars(p, pEnd, value) };
+			if (result.ec != std::errc{})
+				return false;
+			p = result.ptr;
+			return true;
+		}
+
+		static bool ReadFloats(const char* p, const char* pEnd, float* pValues, int nrValues)
+		{
+			for (int i{}; i < nrValues; ++i)
+			{
+				p = SkipSpaces(p, pEnd);
+				if (!ReadNumber(p, pEnd, pValues[i]))
+					return false;
+			}
+			return true;
+		}
+
+		/**
+		 * \brief OBJ indices are 1 based, or relative to the end of the elements read so far when negative
+		 * \param nrRead elements before this line in the whole file
+		 * \param nrTotal elements in the whole file
+		 */
+		static bool ResolveIndex(int objIndex, size_t nrRead, size_t nrTotal, int& index)
+		{
+			const int64_t resolved{ objIndex > 0 ? int64_t(objIndex) - 1 : int64_t(nrRead) + objIndex };
+			if (objIndex == 0 || resolved < 0 || resolved >= int64_t(nrTotal))
+				return false;
+			index = static_cast<int>(resolved);
+			return true;
+		}
+
+		//First pass, only looks at the keywords and counts the corners of faces
+		static ObjCounts CountChunk(const char* p, const char* pEnd)
+		{
+			ObjCounts counts{};
+			while (p < pEnd)
+			{
+				const char* pLineEnd{ FindLineEnd(p, pEnd) };
+				switch (ReadKeyword(p, pLineEnd))
+				{
+				case ObjLine::Position:
+					++counts.positions;
+					break;
+				case ObjLine::Uv:
+					++counts.uvs;
+					break;
+				case ObjLine::Normal:
+					++counts.normals;
+					break;
+				case ObjLine::Face:
+				{
+					size_t nrCorners{};
+					for (p = SkipSpaces(p, pLineEnd); p != pLineEnd; p = SkipSpaces(p, pLineEnd))
+					{
+						++nrCorners;
+						while (p != pLineEnd && !IsSpace(*p))
+						{
+							++p;
+						}
+					}
+					counts.triangles += nrCorners > 2 ? nrCorners - 2 : 0;
+					break;
+				}
+				default:
+					break;
+				}
+				p = pLineEnd == pEnd ? pEnd : pLineEnd + 1;
+			}
+			return counts;
+		}
+
+		//Second pass, writes the chunk at its offsets into the arrays that already have their final size
+		static bool ParseChunk(const char* p, const char* pEnd, const ObjCounts& offsets, ObjData& data)
+		{
+			ObjCounts read{ offsets };
+			while (p < pEnd)
+			{
+				const char* pLineEnd{ FindLineEnd(p, pEnd) };
+				switch (ReadKeyword(p, pLineEnd))
+				{
+				case ObjLine::Position:
+				{
+					float values[3]{};
+					if (!ReadFloats(p, pLineEnd, values, 3))
+						return false;
+					data.positions[read.positions++] = Vector3{ values[0], values[1], values[2] };
+					break;
+				}
+				case ObjLine::Uv:
+				{
+					float values[2]{};
+					if (!ReadFloats(p, pLineEnd, values, 2))
+						return false;
+					data.uvs[read.uvs++] = Vector2{ values[0], values[1] };
+					break;
+				}
+				case ObjLine::Normal:
+				{
+					float values[3]{};
+					if (!ReadFloats(p, pLineEnd, values, 3))
+						return false;
+					data.normals[read.normals++] = Vector3{ values[0], values[1], values[2] };
+					break;
+				}
+				case ObjLine::Face:
+				{
+					//Corners are v, v/vt, v//vn or v/vt/vn, a polygon becomes a fan around its first corner
+					ObjCorner first{};
+					ObjCorner previous{};
+					int nrCorners{};
+					for (p = SkipSpaces(p, pLineEnd); p != pLineEnd; p = SkipSpaces(p, pLineEnd))
+					{
+						ObjCorner corner{};
+						int objIndex{};
+						if (!ReadNumber(p, pLineEnd, objIndex) || !ResolveIndex(objIndex, read.positions, data.positions.size(), corner.position))
+							return false;
+
+						if (p != pLineEnd && *p == '/')
+						{
+							++p;
+							if (p != pLineEnd && *p != '/')
+							{
+								if (!ReadNumber(p, pLineEnd, objIndex) || !ResolveIndex(objIndex, read.uvs, data.uvs.size(), corner.uv))
+									return false;
+							}
+							if (p != pLineEnd && *p == '/')
+							{
+								++p;
+								if (!ReadNumber(p, pLineEnd, objIndex) || !ResolveIndex(objIndex, read.normals, data.normals.size(), corner.normal))
+									return false;
+							}
+						}
+						if (p != pLineEnd && !IsSpace(*p))
+							return false;
+
+						if (nrCorners == 0)
+						{
+							first = corner;
+						}
+						else if (nrCorners >= 2)
+						{
+							ObjCorner* pTriangle{ &data.corners[read.triangles++ * 3] };
+							pTriangle[0] = first;
+							pTriangle[1] = previous;
+							pTriangle[2] = corner;
+						}
+						previous = corner;
+						++nrCorners;
+					}
+					//A point or a line has no triangle to draw
+					if (nrCorners < 3)
+						return false;
+					break;
+				}
+				default:
+					break;
+				}
+				p = pLineEnd == pEnd ? pEnd : pLineEnd + 1;
+			}
+			return true;
+		}
+
+		bool ParseOBJFile(const std::string& filename, ObjData& data, uint32_t nrThreads)
+		{
+			const MappedFile file{ filename };
+			if (!file.IsOpen())
+				return false;
+
+			const char* pBegin{ file.GetData() };
+			const char* pEnd{ pBegin + file.GetSize() };
+
+			if (nrThreads == 0)
+			{
+				nrThreads = std::max(1u, std::thread::hardware_concurrency());
+			}
+			const uint32_t nrChunks{ static_cast<uint32_t>(std::clamp<size_t>(file.GetSize() / MinChunkSize, 1, nrThreads)) };
+
+			//Chunks end after a newline so no line is split, the last one takes the rest
+			std::vector<const char*> chunkStarts(nrChunks + 1);
+			chunkStarts[0] = pBegin;
+			for (uint32_t chunk{ 1 }; chunk < nrChunks; ++chunk)
+			{
+				const char* pSplit{ std::max(pBegin + file.GetSize() * chunk / nrChunks, chunkStarts[chunk - 1]) };
+				const char* pLineEnd{ FindLineEnd(pSplit, pEnd) };
+				chunkStarts[chunk] = pLineEnd == pEnd ? pEnd : pLineEnd + 1;
+			}
+			chunkStarts[nrChunks] = pEnd;
+
+			ThreadPool threadPool{ nrChunks };
+
+			std::vector<ObjCounts> chunkCounts(nrChunks);
+			threadPool.ParallelFor(nrChunks, [&](uint32_t chunk, uint32_t)
+				{
+					chunkCounts[chunk] = CountChunk(chunkStarts[chunk], chunkStarts[chunk + 1]);
+				});
+
+			//Each chunk writes behind the elements of the chunks before it, so the order is the file order whatever the threads do
+			std::vector<ObjCounts> chunkOffsets(nrChunks);
+			ObjCounts total{};
+			for (uint32_t chunk{}; chunk < nrChunks; ++chunk)
+			{
+				chunkOffsets[chunk] = total;
+				total.positions += chunkCounts[chunk].positions;
+				total.uvs += chunkCounts[chunk].uvs;
+				total.normals += chunkCounts[chunk].normals;
+				total.triangles += chunkCounts[chunk].triangles;
+			}
+
+			data.positions.assign(total.positions, Vector3{});
+			data.uvs.assign(total.uvs, Vector2{});
+			data.normals.assign(total.normals, Vector3{});
+			data.corners.assign(total.triangles * 3, ObjCorner{});
+
+			std::vector<char> isChunkParsed(nrChunks);
+			threadPool.ParallelFor(nrChunks, [&](uint32_t chunk, uint32_t)
+				{
+					isChunkParsed[chunk] = ParseChunk(chunkStarts[chunk], chunkStarts[chunk + 1], chunkOffsets[chunk], data);
+				});
+
+			return std::all_of(isChunkParsed.begin(), isChunkParsed.end(), [](char isParsed) { return isParsed != 0; });
+		}
+	}
+}
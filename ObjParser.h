@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Vector2.h"
+#include "Vector3.h"
+
+namespace dae
+{
+	namespace Utils
+	{
+		//A face corner, 0 based indices into the attribute arrays, -1 when the corner has no such attribute
+		struct ObjCorner
+		{
+			int position{};
+			int uv{ -1 };
+			int normal{ -1 };
+
+			bool operator==(const ObjCorner& other) const = default;
+		};
+
+		struct ObjCornerHash
+		{
+			size_t operator()(const ObjCorner& corner) const
+			{
+				//large odd multipliers spread the small, dense indices over the whole word
+				const uint64_t hash{ uint64_t(uint32_t(corner.position)) * 0x9E3779B97F4A7C15ull
+					^ uint64_t(uint32_t(corner.uv)) * 0xC2B2AE3D27D4EB4Full
+					^ uint64_t(uint32_t(corner.normal)) * 0x165667B19E3779F9ull };
+				return static_cast<size_t>(hash ^ (hash >> 32));
+			}
+		};
+
+		//Contents of an OBJ file as written, polygons are split into fans of triangles
+		struct ObjData
+		{
+			std::vector<Vector3> positions{};
+			std::vector<Vector2> uvs{};
+			std::vector<Vector3> normals{};
+			std::vector<ObjCorner> corners{}; //3 per triangle
+		};
+
+		/**
+		 * \brief Parses the v, vt, vn and f lines of a memory mapped OBJ file, every other line is skipped
+		 * \param nrThreads large files are split into chunks parsed in parallel, 0 = one per hardware thread. The result does not depend on it
+		 * \return false when the file can not be opened, a line is malformed, a face has less than 3 corners or indexes outside the attributes
+		 */
+		bool ParseOBJFile(const std::string& filename, ObjData& data, uint32_t nrThreads = 0);
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include "Math.h"
+
+namespace dae
+{
+	namespace Rasterizer
+	{
+		//Screen positions are snapped to 16.8 fixed point (1/256th of a pixel)
+		constexpr int SubPixelBits{ 8 };
+		constexpr int64_t SubPixelOne{ int64_t(1) << SubPixelBits };
+		constexpr int64_t SubPixelHalf{ SubPixelOne / 2 };
+
+		inline int64_t ToFixed(float v)
+		{
+			return static_cast<int64_t>(std::llround(v * static_cast<float>(SubPixelOne)));
+		}
+
+		/**
+		 * \brief Edge function E(x, y) = a * x + b * y + c in fixed point, a pixel is inside when E >= 0
+		 * The top-left fill rule is already folded into c
+		 */
+		struct Edge
+		{
+			int64_t a{};
+			int64_t b{};
+			int64_t c{};
+
+			//value at the center of pixel (px, py)
+			int64_t At(int px, int py) const
+			{
+				return a * (px * SubPixelOne + SubPixelHalf) + b * (py * SubPixelOne + SubPixelHalf) + c;
+			}
+
+			//increments when moving one pixel right or one pixel down
+			int64_t StepX() const { return a * SubPixelOne; }
+			int64_t StepY() const { return b * SubPixelOne; }
+		};
+
+		//Screen space winding dropped by SetupTriangle, clockwise is front facing like the hardware rasterizer states
+		enum class CullWinding
+		{
+			None,
+			Clockwise,
+			CounterClockwise
+		};
+
+		struct TriangleSetup
+		{
+			//edges[i] lies opposite of vertex i, E / (2 * area) is the barycentric weight of vertex i
+			Edge edges[3]{};
+			float invDoubleArea{};
+
+			//bounds of the covered pixel centers, max is exclusive
+			int minX{};
+			int minY{};
+			int maxX{};
+			int maxY{};
+		};
+
+		/**
+		 * \brief Builds the fixed point edge functions of a screen space triangle
+		 * \param cull winding to drop, the other one is flipped so both rasterize the same way
+		 * \return false when the triangle is culled, has no area after snapping or its bounds contain no pixel center
+		 */
+		inline bool SetupTriangle(const Vector4& v0, const Vector4& v1, const Vector4& v2, TriangleSetup& setup, CullWinding cull = CullWinding::None)
+		{
+			const int64_t x[3]{ ToFixed(v0.x), ToFixed(v1.x), ToFixed(v2.x) };
+			const int64_t y[3]{ ToFixed(v0.y), ToFixed(v1.y), ToFixed(v2.y) };
+
+			//Positive for clockwise triangles, y points down on screen
+			int64_t doubleArea{ (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]) };
+			if (doubleArea == 0)
+				return false;
+			if (cull == CullWinding::Clockwise && doubleArea > 0)
+				return false;
+			if (cull == CullWinding::CounterClockwise && doubleArea < 0)
+				return false;
+
+			//Pixel centers inside the bounding box, slivers between the centers never cover anything
+			const int64_t minX{ std::min(std::min(x[0], x[1]), x[2]) };
+			const int64_t minY{ std::min(std::min(y[0], y[1]), y[2]) };
+			const int64_t maxX{ std::max(std::max(x[0], x[1]), x[2]) };
+			const int64_t maxY{ std::max(std::max(y[0], y[1]), y[2]) };
+			setup.minX = static_cast<int>((minX - SubPixelHalf + SubPixelOne - 1) >> SubPixelBits);
+			setup.minY = static_cast<int>((minY - SubPixelHalf + SubPixelOne - 1) >> SubPixelBits);
+			setup.maxX = static_cast<int>((maxX - SubPixelHalf) >> SubPixelBits) + 1;
+			setup.maxY = static_cast<int>((maxY - SubPixelHalf) >> SubPixelBits) + 1;
+			if (setup.minX >= setup.maxX || setup.minY >= setup.maxY)
+				return false;
+
+			//flip the edges of the other winding so the inside is always positive
+			const int64_t sign{ doubleArea > 0 ? 1 : -1 };
+			doubleArea *= sign;
+
+			for (int i{}; i < 3; ++i)
+			{
+				//edge from vertex i + 1 to vertex i + 2
+				const int from{ (i + 1) % 3 };
+				const int to{ (i + 2) % 3 };
+				const int64_t dx{ (x[to] - x[from]) * sign };
+				const int64_t dy{ (y[to] - y[from]) * sign };
+
+				Edge& edge{ setup.edges[i] };
+				edge.a = -dy;
+				edge.b = dx;
+				edge.c = dy * x[from] - dx * y[from];
+
+				//Top-left rule: pixel centers exactly on an edge only belong to the triangle if it is a top edge
+				//(horizontal with the inside below) or a left edge (inside to the right), so shared edges are drawn once
+				const bool isTopLeft{ (dy == 0 && dx > 0) || dy < 0 };
+				if (!isTopLeft)
+				{
+					edge.c -= 1;
+				}
+			}
+
+			setup.invDoubleArea = 1.f / static_cast<float>(doubleArea);
+			return true;
+		}
+	}
+}
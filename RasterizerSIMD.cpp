@@ -0,0 +1,325 @@
+#include "pch.h"
+#include "RasterizerSIMD.h"
+#include "Mesh.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+
+namespace dae
+{
+	namespace Rasterizer
+	{
+		void SetupSpan(const Vertex_PosColOut* const triangle[3], const TriangleSetup& setup, SpanSetup& spanSetup)
+		{
+			spanSetup.originX = setup.minX;
+			spanSetup.originY = setup.minY;
+
+			//Barycentric weight of every vertex at the origin and its change per pixel
+			float weight[3]{};
+			float weightDx[3]{};
+			float weightDy[3]{};
+			for (int k{}; k < 3; ++k)
+			{
+				const Edge& edge{ setup.edges[k] };
+				const int64_t stepX{ edge.StepX() };
+				for (int i{}; i < SpanWidth; ++i)
+				{
+					spanSetup.laneEdges[k][i] = stepX * i;
+				}
+				spanSetup.spanStep[k] = stepX * SpanWidth;
+
+				weight[k] = static_cast<float>(edge.At(setup.minX, setup.minY)) * setup.invDoubleArea;
+				weightDx[k] = static_cast<float>(stepX) * setup.invDoubleArea;
+				weightDy[k] = static_cast<float>(edge.StepY()) * setup.invDoubleArea;
+			}
+
+			const auto makePlane{ [&](float v0, float v1, float v2)
+				{
+					return AttributePlane{
+						weightDx[0] * v0 + weightDx[1] * v1 + weightDx[2] * v2,
+						weightDy[0] * v0 + weightDy[1] * v1 + weightDy[2] * v2,
+						weight[0] * v0 + weight[1] * v1 + weight[2] * v2 };
+				} };
+
+			const Vertex_PosColOut& v0{ *triangle[0] };
+			const Vertex_PosColOut& v1{ *triangle[1] };
+			const Vertex_PosColOut& v2{ *triangle[2] };
+			const float invW[3]{ 1.f / v0.Pos.w, 1.f / v1.Pos.w, 1.f / v2.Pos.w };
+			const auto makePerspectivePlane{ [&](float a0, float a1, float a2)
+				{
+					return makePlane(a0 * invW[0], a1 * invW[1], a2 * invW[2]);
+				} };
+
+			spanSetup.invZ = makePlane(1.f / v0.Pos.z, 1.f / v1.Pos.z, 1.f / v2.Pos.z);
+			spanSetup.invW = makePlane(invW[0], invW[1], invW[2]);
+
+			spanSetup.attributes[AttrU] = makePerspectivePlane(v0.Uv.x, v1.Uv.x, v2.Uv.x);
+			spanSetup.attributes[AttrV] = makePerspectivePlane(v0.Uv.y, v1.Uv.y, v2.Uv.y);
+			spanSetup.attributes[AttrNormalX] = makePerspectivePlane(v0.Normal.x, v1.Normal.x, v2.Normal.x);
+			spanSetup.attributes[AttrNormalY] = makePerspectivePlane(v0.Normal.y, v1.Normal.y, v2.Normal.y);
+			spanSetup.attributes[AttrNormalZ] = makePerspectivePlane(v0.Normal.z, v1.Normal.z, v2.Normal.z);
+			spanSetup.attributes[AttrTangentX] = makePerspectivePlane(v0.Tangent.x, v1.Tangent.x, v2.Tangent.x);
+			spanSetup.attributes[AttrTangentY] = makePerspectivePlane(v0.Tangent.y, v1.Tangent.y, v2.Tangent.y);
+			spanSetup.attributes[AttrTangentZ] = makePerspectivePlane(v0.Tangent.z, v1.Tangent.z, v2.Tangent.z);
+			spanSetup.attributes[AttrViewX] = makePerspectivePlane(v0.viewDirection.x, v1.viewDirection.x, v2.viewDirection.x);
+			spanSetup.attributes[AttrViewY] = makePerspectivePlane(v0.viewDirection.y, v1.viewDirection.y, v2.viewDirection.y);
+			spanSetup.attributes[AttrViewZ] = makePerspectivePlane(v0.viewDirection.z, v1.viewDirection.z, v2.viewDirection.z);
+			//the position has always been interpolated without the divide by w
+			spanSetup.attributes[AttrPosX] = makePlane(v0.Pos.x, v1.Pos.x, v2.Pos.x);
+			spanSetup.attributes[AttrPosY] = makePlane(v0.Pos.y, v1.Pos.y, v2.Pos.y);
+			spanSetup.attributes[AttrPosZ] = makePlane(v0.Pos.z, v1.Pos.z, v2.Pos.z);
+			spanSetup.attributes[AttrPosW] = makePlane(v0.Pos.w, v1.Pos.w, v2.Pos.w);
+		}
+
+		//Value of a plane at the first pixel of a span
+		static float PlaneAt(const AttributePlane& plane, float offsetX, float offsetY)
+		{
+			return plane.c + plane.dx * offsetX + plane.dy * offsetY;
+		}
+
+		void ComputeQuadDerivatives(const SpanSetup& spanSetup, int px, int py, SpanDerivatives& derivatives)
+		{
+			const AttributePlane& planeU{ spanSetup.attributes[AttrU] };
+			const AttributePlane& planeV{ spanSetup.attributes[AttrV] };
+			const float offsetX{ static_cast<float>(px - spanSetup.originX) };
+
+			//Both rows of the quads, the row of the span is one of them
+			float u[2][SpanWidth]{};
+			float v[2][SpanWidth]{};
+			for (int row{}; row < 2; ++row)
+			{
+				const float offsetY{ static_cast<float>((py & ~1) + row - spanSetup.originY) };
+				const float invW{ PlaneAt(spanSetup.invW, offsetX, offsetY) };
+				const float uOverW{ PlaneAt(planeU, offsetX, offsetY) };
+				const float vOverW{ PlaneAt(planeV, offsetX, offsetY) };
+				for (int i{}; i < SpanWidth; ++i)
+				{
+					const float lane{ static_cast<float>(i) };
+					const float w{ 1.f / (invW + spanSetup.invW.dx * lane) };
+					u[row][i] = (uOverW + planeU.dx * lane) * w;
+					v[row][i] = (vOverW + planeV.dx * lane) * w;
+				}
+			}
+
+			//Fine derivatives, ddx within the row of the pixel and ddy within its column
+			const int row{ py & 1 };
+			for (int i{}; i < SpanWidth; ++i)
+			{
+				const int left{ i & ~1 };
+				derivatives.dUdx[i] = u[row][left + 1] - u[row][left];
+				derivatives.dVdx[i] = v[row][left + 1] - v[row][left];
+				derivatives.dUdy[i] = u[1][i] - u[0][i];
+				derivatives.dVdy[i] = v[1][i] - v[0][i];
+			}
+		}
+
+		template<bool TestCoverage, bool Interpolate>
+		static void RasterizeSpanScalar(const SpanSetup& spanSetup, const int64_t edges[3], int px, int py, float* pDepth, Span& span)
+		{
+			const float offsetX{ static_cast<float>(px - spanSetup.originX) };
+			const float offsetY{ static_cast<float>(py - spanSetup.originY) };
+			const float invZ{ PlaneAt(spanSetup.invZ, offsetX, offsetY) };
+			const float invW{ PlaneAt(spanSetup.invW, offsetX, offsetY) };
+
+			span.mask = 0;
+			for (int i{}; i < SpanWidth; ++i)
+			{
+				if constexpr (TestCoverage)
+				{
+					const int64_t e0{ edges[0] + spanSetup.laneEdges[0][i] };
+					const int64_t e1{ edges[1] + spanSetup.laneEdges[1][i] };
+					const int64_t e2{ edges[2] + spanSetup.laneEdges[2][i] };
+					if ((e0 | e1 | e2) < 0)
+						continue;
+				}
+
+				const float lane{ static_cast<float>(i) };
+				const float depth{ 1.f / (invZ + spanSetup.invZ.dx * lane) };
+				if (!(depth <= pDepth[i]))
+					continue;
+				pDepth[i] = depth;
+
+				span.mask |= 1u << i;
+				span.depth[i] = depth;
+
+				if constexpr (Interpolate)
+				{
+					const float interpolatedW{ 1.f / (invW + spanSetup.invW.dx * lane) };
+					for (int a{}; a < NrSpanAttributes; ++a)
+					{
+						const AttributePlane& attribute{ spanSetup.attributes[a] };
+						span.attributes[a][i] = (PlaneAt(attribute, offsetX, offsetY) + attribute.dx * lane) * interpolatedW;
+					}
+				}
+			}
+		}
+
+		template<bool TestCoverage, bool Interpolate>
+		static void RasterizeSpanSSE4(const SpanSetup& spanSetup, const int64_t edges[3], int px, int py, float* pDepth, Span& span)
+		{
+			uint32_t mask{ 0xFF };
+			if constexpr (TestCoverage)
+			{
+				//Coverage, 2 lanes of 64 bit edges per register, a pixel is outside when any edge is negative
+				int outside{};
+				for (int quarter{}; quarter < 4; ++quarter)
+				{
+					__m128i edgeOr{ _mm_setzero_si128() };
+					for (int k{}; k < 3; ++k)
+					{
+						const __m128i lanes{ _mm_load_si128(reinterpret_cast<const __m128i*>(&spanSetup.laneEdges[k][quarter * 2])) };
+						edgeOr = _mm_or_si128(edgeOr, _mm_add_epi64(_mm_set1_epi64x(edges[k]), lanes));
+					}
+					outside |= _mm_movemask_pd(_mm_castsi128_pd(edgeOr)) << (quarter * 2);
+				}
+
+				mask &= ~static_cast<uint32_t>(outside);
+				span.mask = 0;
+				if (mask == 0)
+					return;
+			}
+
+			const float offsetX{ static_cast<float>(px - spanSetup.originX) };
+			const float offsetY{ static_cast<float>(py - spanSetup.originY) };
+			const __m128 lanes[2]{ _mm_setr_ps(0.f, 1.f, 2.f, 3.f), _mm_setr_ps(4.f, 5.f, 6.f, 7.f) };
+			const auto planeLanes{ [&](const AttributePlane& plane, int half)
+				{
+					return _mm_add_ps(_mm_set1_ps(PlaneAt(plane, offsetX, offsetY)), _mm_mul_ps(_mm_set1_ps(plane.dx), lanes[half]));
+				} };
+
+			__m128 depth[2]{};
+			for (int half{}; half < 2; ++half)
+			{
+				//Depth test
+				depth[half] = _mm_div_ps(_mm_set1_ps(1.f), planeLanes(spanSetup.invZ, half));
+
+				const __m128 buffer{ _mm_loadu_ps(pDepth + half * 4) };
+				const __m128 pass{ _mm_cmple_ps(depth[half], buffer) };
+				mask &= ~(static_cast<uint32_t>(~_mm_movemask_ps(pass) & 0xF) << (half * 4));
+			}
+
+			span.mask = mask;
+			if (mask == 0)
+				return;
+
+			const __m128i laneBits{ _mm_setr_epi32(1, 2, 4, 8) };
+			for (int half{}; half < 2; ++half)
+			{
+				const __m128i halfMask{ _mm_set1_epi32(static_cast<int>(mask >> (half * 4))) };
+				const __m128 write{ _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(halfMask, laneBits), laneBits)) };
+				const __m128 buffer{ _mm_loadu_ps(pDepth + half * 4) };
+				_mm_storeu_ps(pDepth + half * 4, _mm_blendv_ps(buffer, depth[half], write));
+				_mm_store_ps(span.depth + half * 4, depth[half]);
+
+				if constexpr (Interpolate)
+				{
+					//Perspective correct attributes
+					const __m128 interpolatedW{ _mm_div_ps(_mm_set1_ps(1.f), planeLanes(spanSetup.invW, half)) };
+					for (int a{}; a < NrSpanAttributes; ++a)
+					{
+						_mm_store_ps(&span.attributes[a][half * 4], _mm_mul_ps(planeLanes(spanSetup.attributes[a], half), interpolatedW));
+					}
+				}
+			}
+		}
+
+		template<bool TestCoverage, bool Interpolate>
+		static void RasterizeSpanAVX2(const SpanSetup& spanSetup, const int64_t edges[3], int px, int py, float* pDepth, Span& span)
+		{
+			uint32_t mask{ 0xFF };
+			if constexpr (TestCoverage)
+			{
+				//Coverage, 4 lanes of 64 bit edges per register, a pixel is outside when any edge is negative
+				__m256i edgeOrLo{ _mm256_setzero_si256() };
+				__m256i edgeOrHi{ _mm256_setzero_si256() };
+				for (int k{}; k < 3; ++k)
+				{
+					const __m256i edge{ _mm256_set1_epi64x(edges[k]) };
+					edgeOrLo = _mm256_or_si256(edgeOrLo, _mm256_add_epi64(edge, _mm256_load_si256(reinterpret_cast<const __m256i*>(&spanSetup.laneEdges[k][0]))));
+					edgeOrHi = _mm256_or_si256(edgeOrHi, _mm256_add_epi64(edge, _mm256_load_si256(reinterpret_cast<const __m256i*>(&spanSetup.laneEdges[k][4]))));
+				}
+				const int outside{ _mm256_movemask_pd(_mm256_castsi256_pd(edgeOrLo)) | (_mm256_movemask_pd(_mm256_castsi256_pd(edgeOrHi)) << 4) };
+
+				mask &= ~static_cast<uint32_t>(outside);
+				span.mask = 0;
+				if (mask == 0)
+					return;
+			}
+
+			const float offsetX{ static_cast<float>(px - spanSetup.originX) };
+			const float offsetY{ static_cast<float>(py - spanSetup.originY) };
+			const __m256 lanes{ _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f) };
+			const auto planeLanes{ [&](const AttributePlane& plane)
+				{
+					return _mm256_fmadd_ps(_mm256_set1_ps(plane.dx), lanes, _mm256_set1_ps(PlaneAt(plane, offsetX, offsetY)));
+				} };
+
+			//Depth test
+			const __m256 depth{ _mm256_div_ps(_mm256_set1_ps(1.f), planeLanes(spanSetup.invZ)) };
+			const __m256 pass{ _mm256_cmp_ps(depth, _mm256_loadu_ps(pDepth), _CMP_LE_OQ) };
+			mask &= static_cast<uint32_t>(_mm256_movemask_ps(pass));
+
+			span.mask = mask;
+			if (mask == 0)
+				return;
+
+			const __m256i laneBits{ _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128) };
+			const __m256i write{ _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(mask)), laneBits), laneBits) };
+			_mm256_maskstore_ps(pDepth, write, depth);
+			_mm256_store_ps(span.depth, depth);
+			if constexpr (!Interpolate)
+				return;
+
+			//Perspective correct attributes, one reciprocal and a multiply-add per attribute
+			const __m256 interpolatedW{ _mm256_div_ps(_mm256_set1_ps(1.f), planeLanes(spanSetup.invW)) };
+			for (int a{}; a < NrSpanAttributes; ++a)
+			{
+				_mm256_store_ps(span.attributes[a], _mm256_mul_ps(planeLanes(spanSetup.attributes[a]), interpolatedW));
+			}
+		}
+
+		bool HasAVX2()
+		{
+			int info[4]{};
+			__cpuid(info, 0);
+			if (info[0] < 7)
+				return false;
+
+			//avx, fma and the os saving the ymm registers
+			__cpuid(info, 1);
+			const bool hasFMA{ (info[2] & (1 << 12)) != 0 };
+			const bool hasOSXSAVE{ (info[2] & (1 << 27)) != 0 };
+			const bool hasAVX{ (info[2] & (1 << 28)) != 0 };
+			if (!hasFMA || !hasOSXSAVE || !hasAVX)
+				return false;
+			if ((_xgetbv(0) & 0x6) != 0x6)
+				return false;
+
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+		}
+
+		bool HasSSE4()
+		{
+			int info[4]{};
+			__cpuid(info, 1);
+			return (info[2] & (1 << 19)) != 0;
+		}
+
+		const SpanFunctions& GetSpanFunctions()
+		{
+			static const SpanFunctions avx2{
+				RasterizeSpanAVX2<true, true>, RasterizeSpanAVX2<false, true>,
+				RasterizeSpanAVX2<true, false>, RasterizeSpanAVX2<false, false>, "AVX2" };
+			static const SpanFunctions sse4{
+				RasterizeSpanSSE4<true, true>, RasterizeSpanSSE4<false, true>,
+				RasterizeSpanSSE4<true, false>, RasterizeSpanSSE4<false, false>, "SSE4.1" };
+			static const SpanFunctions scalar{
+				RasterizeSpanScalar<true, true>, RasterizeSpanScalar<false, true>,
+				RasterizeSpanScalar<true, false>, RasterizeSpanScalar<false, false>, "SCALAR" };
+
+			static const SpanFunctions& functions{ HasAVX2() ? avx2 : HasSSE4() ? sse4 : scalar };
+			return functions;
+		}
+	}
+}
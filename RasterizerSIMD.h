@@ -0,0 +1,100 @@
+#pragma once
+#include "Rasterizer.h"
+
+struct Vertex_PosColOut;
+
+namespace dae
+{
+	namespace Rasterizer
+	{
+		//Pixels handled per call of a span function
+		constexpr int SpanWidth{ 8 };
+
+		//Attributes interpolated (perspective correct) for every pixel of a span
+		enum SpanAttribute : int
+		{
+			AttrU, AttrV,
+			AttrNormalX, AttrNormalY, AttrNormalZ,
+			AttrTangentX, AttrTangentY, AttrTangentZ,
+			AttrViewX, AttrViewY, AttrViewZ,
+			AttrPosX, AttrPosY, AttrPosZ, AttrPosW,
+			NrSpanAttributes
+		};
+
+		//Screen space plane equation, value = c + dx * (px - originX) + dy * (py - originY) at pixel centers
+		struct AttributePlane
+		{
+			float dx{};
+			float dy{};
+			float c{};
+		};
+
+		//Per triangle constants of the span functions
+		struct SpanSetup
+		{
+			//edge increments of lane i relative to lane 0, and for moving a whole span to the right
+			alignas(32) int64_t laneEdges[3][SpanWidth]{};
+			int64_t spanStep[3]{};
+
+			//planes are relative to the first pixel of the bounding box so the offsets stay small
+			int originX{};
+			int originY{};
+			AttributePlane invZ{};
+			AttributePlane invW{};
+			AttributePlane attributes[NrSpanAttributes]{}; //attribute / w
+		};
+
+		struct Span
+		{
+			//bit i is set when pixel i is covered and passed the depth test
+			uint32_t mask{};
+			alignas(32) float depth[SpanWidth]{};
+			alignas(32) float attributes[NrSpanAttributes][SpanWidth]{};
+		};
+
+		//Screen space uv derivatives of every pixel of a span
+		struct SpanDerivatives
+		{
+			alignas(32) float dUdx[SpanWidth]{};
+			alignas(32) float dUdy[SpanWidth]{};
+			alignas(32) float dVdx[SpanWidth]{};
+			alignas(32) float dVdy[SpanWidth]{};
+		};
+
+		void SetupSpan(const Vertex_PosColOut* const triangle[3], const TriangleSetup& setup, SpanSetup& spanSetup);
+
+		/**
+		 * \brief Rasterizes SpanWidth pixels of a row
+		 * \param spanSetup triangle constants
+		 * \param edges edge values at the first pixel of the span
+		 * \param px, py first pixel of the span
+		 * \param pDepth depth buffer at the first pixel, SpanWidth floats, depths of passing pixels are written back
+		 * \param span coverage mask, depth and interpolated attributes of every pixel
+		 */
+		using SpanFunction = void(*)(const SpanSetup& spanSetup, const int64_t edges[3], int px, int py, float* pDepth, Span& span);
+
+		struct SpanFunctions
+		{
+			SpanFunction partial{ nullptr }; //tests the coverage of every pixel
+			SpanFunction covered{ nullptr }; //skips the coverage test, for spans known to be inside the triangle
+			//variants that only test and write depth, span.attributes is left untouched
+			SpanFunction partialDepthOnly{ nullptr };
+			SpanFunction coveredDepthOnly{ nullptr };
+			const char* name{};
+		};
+
+		/**
+		 * \brief Uv derivatives of a span shaded as 2x2 pixel quads, lanes (2i, 2i + 1) of rows (2j, 2j + 1)
+		 * The helper pixels of a quad come from the plane equations, so they exist whether or not they are covered
+		 * \param px, py first pixel of the span, px has to be even
+		 */
+		void ComputeQuadDerivatives(const SpanSetup& spanSetup, int px, int py, SpanDerivatives& derivatives);
+
+		//AVX2 when the cpu and os support it, SSE4.1 otherwise
+		const SpanFunctions& GetSpanFunctions();
+
+		//Cpu features, AVX2 includes FMA and the os saving the ymm registers
+		bool HasAVX2();
+		bool HasSSE4();
+	}
+}
@@ -3,7 +3,8 @@
 
 #include "Effect.h"
 #include "Material.h"
-#include "Utils.h"
+
+#include <bit>
 
 namespace dae {
 
@@ -19,7 +20,18 @@ namespace dae {
 		//Create Buffers
 		m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
 		m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
-		m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
+
+		const SDL_PixelFormat* pFrontFormat{ m_pFrontBuffer->format };
+		m_IsPresentingDirectly =
+			pFrontFormat->BytesPerPixel == 4 && m_pFrontBuffer->pitch == m_Width * 4 &&
+			pFrontFormat->Rloss == 0 && pFrontFormat->Gloss == 0 && pFrontFormat->Bloss == 0;
+		m_pPresentSurface = m_IsPresentingDirectly ? m_pFrontBuffer : m_pBackBuffer;
+
+		const SDL_PixelFormat* pPresentFormat{ m_pPresentSurface->format };
+		m_PixelFormat = Rasterizer::PixelFormat{ pPresentFormat->Rshift, pPresentFormat->Gshift, pPresentFormat->Bshift, pPresentFormat->Amask };
+		m_pBackBufferPixels = static_cast<uint32_t*>(m_pPresentSurface->pixels);
+		m_ResolveFunction = Rasterizer::GetResolveFunction();
+		std::cout << "Software rasterizer presents " << (m_IsPresentingDirectly ? "directly into the window surface" : "through a back buffer") << "\n";
 	
 		int size{ m_Width * m_Height };
 		m_ColorBuffer = new ColorRGB[size];
@@ -32,6 +44,36 @@ namespace dae {
 		{
 			m_pDepthBufferPixels[i] = FLT_MAX;
 		}
+		m_pTriangleIdBuffer = new uint32_t[size];
+
+		//Tiles
+		m_NrTilesX = (m_Width + m_TileSize - 1) / m_TileSize;
+		m_NrTilesY = (m_Height + m_TileSize - 1) / m_TileSize;
+		m_Tiles.reserve(m_NrTilesX * m_NrTilesY);
+		for (int ty{ 0 }; ty < m_NrTilesY; ++ty)
+		{
+			for (int tx{ 0 }; tx < m_NrTilesX; ++tx)
+			{
+				m_Tiles.push_back(Tile{
+					tx * m_TileSize,
+					ty * m_TileSize,
+					std::min((tx + 1) * m_TileSize, m_Width),
+					std::min((ty + 1) * m_TileSize, m_Height) });
+			}
+		}
+
+		m_TileIsCleared.resize(m_Tiles.size());
+		m_pHiZBlocks = new float[m_Tiles.size() * m_HiZBlocksPerTile];
+		m_pHiZTiles = new float[m_Tiles.size()];
+
+		m_pThreadPool = new ThreadPool{};
+		m_SpanFunctions = Rasterizer::GetSpanFunctions();
+		std::cout << "Software rasterizer uses " << m_pThreadPool->GetNrWorkers() << " threads and the " << m_SpanFunctions.name << " span path\n";
+		m_NrBinChunks = m_pThreadPool->GetNrWorkers();
+		m_TileBins.resize(m_NrBinChunks * m_Tiles.size());
+		m_ClippedTriangles.resize(m_NrBinChunks);
+		m_ClippedTriangleOffsets.resize(m_NrBinChunks);
+
 		//Hardware
 		//Initialize DirectX pipeline
 		const HRESULT result = InitializeDirectX();
@@ -48,25 +90,15 @@ namespace dae {
 
 		//General
 		//Vehicle
-		std::vector<Vertex_PosCol>vertices{};
-
-		std::vector<uint32_t> indices{};
-
-
 		m_pTexture = Texture::LoadFromFile("Resources/vehicle_diffuse.png", m_pDevice);
 		m_pTextureGloss = Texture::LoadFromFile("Resources/vehicle_gloss.png", m_pDevice);
 		m_pTextureNormal = Texture::LoadFromFile("Resources/vehicle_normal.png", m_pDevice);
 		m_pTextureSpecular = Texture::LoadFromFile("Resources/vehicle_specular.png", m_pDevice);
-		Utils::ParseOBJ("Resources/vehicle.obj",vertices,indices);
-
-		for (Vertex_PosCol& vert : vertices)
-		{
-			vert.Color = { 1,1,1 };
-		}
+		//The software rasterizer samples the packed maps, Morton order keeps the texels of a pixel quad in few cache lines
+		m_pVehicleMaterial = MaterialTexture::CreateFromTextures(m_pTexture, m_pTextureNormal, m_pTextureGloss, m_pTextureSpecular, TextureLayout::Morton);
 
-		m_pVehicleMesh = new Mesh{ m_pDevice, vertices, indices };
-		m_pVehicleMesh->SetIndices(indices); // for software
-		m_pVehicleMesh->SetVertices(vertices); // for software
+		m_pVehicleMesh = LoadMesh("Resources/vehicle.obj", Utils::MeshOrder::VertexCacheAndOverdraw, m_VehicleVertexFormat);
+		m_VertexTransformFunction = Rasterizer::GetVertexTransformFunction(m_pVehicleMesh->vertexStream.GetFormat());
 
 		m_TransMatrix = Matrix::CreateTranslation(0, 0, 50);
 		m_RotMatrix = Matrix::CreateRotationZ(0);
@@ -78,18 +110,9 @@ namespace dae {
 
 		//Fire
 
-		std::vector<Vertex_PosCol>vertices2{};
-		std::vector<uint32_t> indices2{};
 		m_pTextureFire = Texture::LoadFromFile("Resources/fireFX_diffuse.png", m_pDevice);
-		Utils::ParseOBJ("Resources/fireFX.obj",vertices2,indices2);
-		for (Vertex_PosCol& vert2 : vertices2) 
-		{
-			vert2.Color = { 1,1,1 };
-		}
-		m_pCombustionMesh = new Mesh{ m_pDevice, vertices2, indices2 };
-
-		m_pCombustionMesh->SetIndices(indices2); // for software
-		m_pCombustionMesh->SetVertices(vertices2); //  for software
+		//Blended without depth writes, the flames overlap in triangle order, so only the vertices are renumbered
+		m_pCombustionMesh = LoadMesh("Resources/fireFX.obj", Utils::MeshOrder::VertexFetch);
 
 		m_pCombustionMesh->SetWorldMatrix(m_ScaleMatrix * m_RotMatrix * m_TransMatrix);
 		m_pCombustionMesh->m_pEffect->SetMaps(m_pTextureFire);
@@ -115,6 +138,9 @@ namespace dae {
 
 	Renderer::~Renderer()
 	{
+		delete m_pThreadPool;
+		m_pThreadPool = nullptr;
+
 		delete m_pVehicleMesh;
 		m_pVehicleMesh = nullptr;
 
@@ -132,6 +158,8 @@ namespace dae {
 		m_pTextureNormal = nullptr;
 		delete m_pTextureSpecular;
 		m_pTextureSpecular = nullptr;
+		delete m_pVehicleMaterial;
+		m_pVehicleMaterial = nullptr;
 		delete m_pTextureFire;
 		m_pTextureFire = nullptr;
 
@@ -139,6 +167,12 @@ namespace dae {
 		m_pDepthBufferPixels = nullptr;
 		delete[] m_ColorBuffer;
 		m_ColorBuffer = nullptr;
+		delete[] m_pTriangleIdBuffer;
+		m_pTriangleIdBuffer = nullptr;
+		delete[] m_pHiZBlocks;
+		m_pHiZBlocks = nullptr;
+		delete[] m_pHiZTiles;
+		m_pHiZTiles = nullptr;
 
 		m_pBackBufferPixels = nullptr;
 		if (m_pFrontBuffer) {
@@ -169,6 +203,7 @@ namespace dae {
 		m_pBackCullState->Release();
 
 		m_pPointSample->Release();
+		m_pBilinearSample->Release();
 		m_pLinearSample->Release();
 		m_pAnisotropicSample->Release();
 		
@@ -193,7 +228,7 @@ namespace dae {
 	}
 
 
-	void Renderer::Render() const
+	void Renderer::Render()
 	{
 		if(m_IsUsingHardware)
 		{
@@ -327,35 +362,40 @@ namespace dae {
 
 	void Renderer::CycleSampler()
 	{
-		if(m_IsUsingHardware)
-		{
-			SetConsoleTextAttribute(m_Handle, 2);
+		SetConsoleTextAttribute(m_Handle, 14);
 
-			m_SamplerState == SamplerState::Anisotropic ?
-				m_SamplerState = SamplerState(0) :
-				m_SamplerState = SamplerState(static_cast<int>(m_SamplerState) + 1);
+		m_SamplerState == SamplerState::Anisotropic ?
+			m_SamplerState = SamplerState(0) :
+			m_SamplerState = SamplerState(static_cast<int>(m_SamplerState) + 1);
 
-			switch (m_SamplerState)
-			{
-			case SamplerState::Point:
-				m_pVehicleMesh->m_pEffect->SetSampler(m_pPointSample);
-				std::cout << "**(HARDWARE) Sampler Filter = POINT" << std::endl;
+		//Same filters as the hardware sampler descs, bilinear uses the nearest mip, linear is min/mag/mip linear
+		switch (m_SamplerState)
+		{
+		case SamplerState::Point:
+			m_pVehicleMesh->m_pEffect->SetSampler(m_pPointSample);
+			m_TextureFilter = TextureFilter::Point;
+			std::cout << "**(SHARED) Sampler Filter = POINT" << std::endl;
 
-				break;
-			case SamplerState::Linear:
-				m_pVehicleMesh->m_pEffect->SetSampler(m_pLinearSample);
-				std::cout << "**(HARDWARE) Sampler Filter = LINEAR" << std::endl;
+			break;
+		case SamplerState::Bilinear:
+			m_pVehicleMesh->m_pEffect->SetSampler(m_pBilinearSample);
+			m_TextureFilter = TextureFilter::Bilinear;
+			std::cout << "**(SHARED) Sampler Filter = BILINEAR" << std::endl;
 
-				break;
-			case SamplerState::Anisotropic:
-				m_pVehicleMesh->m_pEffect->SetSampler(m_pAnisotropicSample);
-				std::cout << "**(HARDWARE) Sampler Filter = ANISOTROPIC" << std::endl;
+			break;
+		case SamplerState::Linear:
+			m_pVehicleMesh->m_pEffect->SetSampler(m_pLinearSample);
+			m_TextureFilter = TextureFilter::Trilinear;
+			std::cout << "**(SHARED) Sampler Filter = LINEAR" << std::endl;
 
-				break;
-			}
-		}
-		
+			break;
+		case SamplerState::Anisotropic:
+			m_pVehicleMesh->m_pEffect->SetSampler(m_pAnisotropicSample);
+			m_TextureFilter = TextureFilter::Anisotropic;
+			std::cout << "**(SHARED) Sampler Filter = ANISOTROPIC (" << m_MaxAnisotropy << "x)" << std::endl;
 
+			break;
+		}
 	}
 
 	void Renderer::ToggleUniformColor()
@@ -409,6 +449,23 @@ namespace dae {
 		}
 	}
 
+	void Renderer::ToggleVisibilityBuffer()
+	{
+		if (!m_IsUsingHardware)
+		{
+			SetConsoleTextAttribute(m_Handle, 5);
+			m_IsUsingVisibilityBuffer = !m_IsUsingVisibilityBuffer;
+			if (m_IsUsingVisibilityBuffer)
+			{
+				std::cout << "**(SOFTWARE) Visibility Buffer ON" << std::endl;
+			}
+			else
+			{
+				std::cout << "**(SOFTWARE) Visibility Buffer OFF" << std::endl;
+			}
+		}
+	}
+
 	
 
 	void Renderer::ShowKeybindings() const
@@ -418,6 +475,7 @@ namespace dae {
 		std::cout << "[Key Bindings - SHARED]" << std::endl;
 		std::cout << "\t [F1] Toggle Rasterizer Mode (HARDWARE/SOFTWARE)" << std::endl;
 		std::cout << "\t [F2] Toggle Vehicle Rotation (ON/OFF)" << std::endl;
+		std::cout << "\t [F4] Cycle Sampler State (POINT/BILINEAR/LINEAR/ANISOTROPIC)" << std::endl;
 		std::cout << "\t [F9] Cycle CullMode (BACK/FRONT/NONE)" << std::endl;
 		std::cout << "\t [F10] Toggle Uniform ClearColor (ON/OFF)" << std::endl;
 		std::cout << "\t [F11] Toggle Print FPS (ON/OFF)" << std::endl;
@@ -425,7 +483,6 @@ namespace dae {
 		SetConsoleTextAttribute(m_Handle, 2);
 		std::cout << "[Key Bindings - HARDWARE]" << std::endl;
 		std::cout << "\t [F3] Toggle FireFX (ON/OFF)" << std::endl;
-		std::cout << "\t [F4] Cycle Sampler State (POINT/LINEAR/ANISOTROPIC)" << std::endl;
 		std::cout << std::endl;
 		SetConsoleTextAttribute(m_Handle, 5);
 		std::cout << "[Key Bindings - SOFTWARE]" << std::endl;
@@ -433,9 +490,21 @@ namespace dae {
 		std::cout << "\t [F6] Toggle NormalMap (ON/OFF)" << std::endl;
 		std::cout << "\t [F7] Toggle DepthBuffer Visualization (ON/OFF)" << std::endl;
 		std::cout << "\t [F8] Toggle BoundingBox Visualization (ON/OFF)" << std::endl;
+		std::cout << "\t [V] Toggle Visibility Buffer (ON/OFF)" << std::endl;
 
 	}
 
+	Mesh* Renderer::LoadMesh(const std::string& objPath, Utils::MeshOrder order, Rasterizer::VertexFormat format) const
+	{
+		Utils::MeshAsset* pAsset{ Utils::MeshAsset::Load(objPath, order, format) };
+		if (!pAsset)
+		{
+			std::cout << "Could not load " << objPath << std::endl;
+			return new Mesh{ m_pDevice, {}, {} };
+		}
+		return new Mesh{ m_pDevice, pAsset };
+	}
+
 	HRESULT Renderer::InitializeDirectX()
 	{
 		//1. Create Device & DeviceContext
@@ -599,6 +668,25 @@ namespace dae {
 			return result;
 
 
+		D3D11_SAMPLER_DESC bilinearSamp{};
+		bilinearSamp.Filter = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT;
+		bilinearSamp.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+		bilinearSamp.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+		bilinearSamp.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+		bilinearSamp.MinLOD = -FLT_MAX;
+		bilinearSamp.MaxLOD = FLT_MAX;
+		bilinearSamp.MipLODBias = 0.0f;
+		bilinearSamp.MaxAnisotropy = 1;
+		bilinearSamp.ComparisonFunc = D3D11_COMPARISON_NEVER;
+		bilinearSamp.BorderColor[0] = 1.0f;
+		bilinearSamp.BorderColor[1] = 1.0f;
+		bilinearSamp.BorderColor[2] = 1.0f;
+		bilinearSamp.BorderColor[3] = 1.0f;
+		result = m_pDevice->CreateSamplerState(&bilinearSamp, &m_pBilinearSample);
+		if (FAILED(result))
+			return result;
+
+
 		D3D11_SAMPLER_DESC linearSamp{};
 		linearSamp.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
 		linearSamp.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
@@ -626,7 +714,7 @@ namespace dae {
 		AnisotropicSamp.MinLOD = -FLT_MAX;
 		AnisotropicSamp.MaxLOD = FLT_MAX;
 		AnisotropicSamp.MipLODBias = 0.0f;
-		AnisotropicSamp.MaxAnisotropy = 1;
+		AnisotropicSamp.MaxAnisotropy = m_MaxAnisotropy;
 		AnisotropicSamp.ComparisonFunc = D3D11_COMPARISON_NEVER;
 		AnisotropicSamp.BorderColor[0] = 1.0f;
 		AnisotropicSamp.BorderColor[1] = 1.0f;
@@ -655,275 +743,591 @@ namespace dae {
 	}
 
 
-	void Renderer::RenderSoftware() const
+	void Renderer::RenderSoftware()
 	{
-		SDL_LockSurface(m_pBackBuffer);
+		SDL_LockSurface(m_pPresentSurface);
+		m_pBackBufferPixels = static_cast<uint32_t*>(m_pPresentSurface->pixels);
 
 		//RENDER LOGIC
 
-		//ResetBuffers
-		int size{ m_Width * m_Height };
-	
-		for (int i{ 0 }; i < size; i++)
-		{
-			if(m_IsUniformColor)
-			{
-				m_ColorBuffer[i] = m_UniformCol;
-			} else
+		//ResetBuffers, only recorded here, see ClearTile and ResolveTile
+		m_ClearColor = m_IsUniformColor ? m_UniformCol : m_SoftCol;
+		m_ClearPixel = Rasterizer::PackPixel(m_PixelFormat,
+			static_cast<uint8_t>(m_ClearColor.r * 255),
+			static_cast<uint8_t>(m_ClearColor.g * 255),
+			static_cast<uint8_t>(m_ClearColor.b * 255));
+		std::fill(m_TileIsCleared.begin(), m_TileIsCleared.end(), uint8_t(1));
+
+		//Vertex stage, every vertex is transformed once into the mesh's vertices_out, chunks start on a whole batch
+		const Rasterizer::VertexTransform vertexTransform{
+			m_pVehicleMesh->m_WorldMatrix * m_pCamera->viewMatrix * m_pCamera->projectionMatrix,
+			m_pVehicleMesh->m_WorldMatrix,
+			m_pCamera->origin,
+			static_cast<float>(m_Width),
+			static_cast<float>(m_Height) };
+		const uint32_t nrVertices{ m_pVehicleMesh->vertexStream.GetNrVertices() };
+		const uint32_t nrBatches{ (nrVertices + Rasterizer::VertexBatchSize - 1) / Rasterizer::VertexBatchSize };
+		const uint32_t verticesPerChunk{ (nrBatches + m_NrBinChunks - 1) / m_NrBinChunks * Rasterizer::VertexBatchSize };
+		m_pThreadPool->ParallelFor(m_NrBinChunks, [&](uint32_t chunk, uint32_t)
 			{
-				m_ColorBuffer[i] = m_SoftCol;
-			}
-		}
-	
-		for (int i{ 0 }; i < size; i++)
+				const uint32_t firstVertex{ std::min(chunk * verticesPerChunk, nrVertices) };
+				const uint32_t lastVertex{ std::min(firstVertex + verticesPerChunk, nrVertices) };
+				m_VertexTransformFunction(m_pVehicleMesh->vertexStream, vertexTransform,
+					m_pVehicleMesh->vertices_out.data(), m_pVehicleMesh->clipPositions_out.data(), firstVertex, lastVertex);
+			});
+
+		//Binning
+		const uint32_t nrTriangles{ static_cast<uint32_t>(m_pVehicleMesh->m_Indices.size() / 3) };
+		m_TriangleSetups.resize(nrTriangles);
+		for (std::vector<uint32_t>& bin : m_TileBins)
 		{
-			m_pDepthBufferPixels[i] = FLT_MAX;
+			bin.clear();
 		}
 
-		SDL_FillRect(m_pBackBuffer, NULL, 0x000000);
-		if(m_IsUniformColor)
-		{
-			SDL_FillRect(m_pBackBuffer, NULL, 0x191919);
+		const uint32_t trianglesPerChunk{ (nrTriangles + m_NrBinChunks - 1) / m_NrBinChunks };
+		m_pThreadPool->ParallelFor(m_NrBinChunks, [&](uint32_t chunk, uint32_t)
+			{
+				const uint32_t firstTriangle{ std::min(chunk * trianglesPerChunk, nrTriangles) };
+				const uint32_t lastTriangle{ std::min(firstTriangle + trianglesPerChunk, nrTriangles) };
+				BinTriangles(chunk, firstTriangle, lastTriangle);
+			});
 
-		} else
+		uint32_t nrClippedTriangles{};
+		for (uint32_t chunk{}; chunk < m_NrBinChunks; ++chunk)
 		{
-			SDL_FillRect(m_pBackBuffer, NULL, 0x636363);
-
+			m_ClippedTriangleOffsets[chunk] = nrClippedTriangles;
+			nrClippedTriangles += static_cast<uint32_t>(m_ClippedTriangles[chunk].size());
 		}
 
+		//Rasterize, with the visibility buffer every tile is shaded right after its last triangle is rasterized
+		m_pThreadPool->ParallelFor(static_cast<uint32_t>(m_Tiles.size()), [&](uint32_t tileIndex, uint32_t)
+			{
+				RenderTile(tileIndex);
+				if (m_IsUsingVisibilityBuffer && !m_TileIsCleared[tileIndex])
+				{
+					ShadeTile(tileIndex);
+				}
+				ResolveTile(tileIndex);
+			});
 
-	
-		for (int i{}; i < m_pVehicleMesh->m_Indices.size(); i += 3)
+		//@END
+		//Update SDL Surface
+		SDL_UnlockSurface(m_pPresentSurface);
+		if (!m_IsPresentingDirectly)
 		{
-			std::vector<Vertex_PosCol> triangle{ m_pVehicleMesh->m_Vertices[m_pVehicleMesh->m_Indices[i]],m_pVehicleMesh->m_Vertices[m_pVehicleMesh->m_Indices[i + 1]],m_pVehicleMesh->m_Vertices[m_pVehicleMesh->m_Indices[i + 2]] };
+			SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
+		}
+		SDL_UpdateWindowSurface(m_pWindow);
+	}
 
-			std::vector<Vertex_PosColOut> totalVertices;
-			VertexTransformationFunction(triangle, totalVertices, m_pVehicleMesh->m_WorldMatrix);
 
-			RenderTriangle(totalVertices);
+
+
+	void Renderer::BinTriangles(uint32_t chunk, uint32_t firstTriangle, uint32_t lastTriangle)
+	{
+		const size_t nrTiles{ m_Tiles.size() };
+		std::vector<std::vector<uint32_t>>::iterator chunkBins{ m_TileBins.begin() + chunk * nrTiles };
+		const std::span<const uint32_t> indices{ m_pVehicleMesh->m_Indices };
+		const std::vector<Vertex_PosColOut>& vertices{ m_pVehicleMesh->vertices_out };
+
+		const std::vector<Vector4>& clipPositions{ m_pVehicleMesh->clipPositions_out };
+		std::vector<ClippedTriangle>& clippedTriangles{ m_ClippedTriangles[chunk] };
+		clippedTriangles.clear();
+
+		//Culling happens in the triangle setup on the screen space winding, clockwise is front facing
+		Rasterizer::CullWinding cull{ Rasterizer::CullWinding::None };
+		switch (m_RasterState)
+		{
+		case RasterState::Back:
+			cull = Rasterizer::CullWinding::CounterClockwise;
+			break;
+		case RasterState::Front:
+			cull = Rasterizer::CullWinding::Clockwise;
+			break;
+		default:
+			break;
 		}
 
-		//@END
-		//Update SDL Surface
-		SDL_UnlockSurface(m_pBackBuffer);
-		SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
-		SDL_UpdateWindowSurface(m_pWindow);
-	}
+		for (uint32_t triangleIndex{ firstTriangle }; triangleIndex < lastTriangle; ++triangleIndex)
+		{
+			//Primitive assembly
+			const uint32_t i{ triangleIndex * 3 };
+			const uint32_t i0{ indices[i] };
+			const uint32_t i1{ indices[i + 1] };
+			const uint32_t i2{ indices[i + 2] };
+
+			//Triangles completely outside one plane are dropped, triangles inside the near plane and the guard band
+			//go straight to the rasterizer, only the rest pays for clipping
+			const uint32_t clipCode0{ Rasterizer::GetClipCode(clipPositions[i0]) };
+			const uint32_t clipCode1{ Rasterizer::GetClipCode(clipPositions[i1]) };
+			const uint32_t clipCode2{ Rasterizer::GetClipCode(clipPositions[i2]) };
+			if ((clipCode0 & clipCode1 & clipCode2) != 0)
+				continue;
+
+			const uint32_t clipPlanes{ clipCode0 | clipCode1 | clipCode2 };
+			if (clipPlanes == 0)
+			{
+				Rasterizer::TriangleSetup& setup{ m_TriangleSetups[triangleIndex] };
+				if (Rasterizer::SetupTriangle(vertices[i0].Pos, vertices[i1].Pos, vertices[i2].Pos, setup, cull))
+				{
+					BinTriangle(chunkBins, triangleIndex, setup);
+				}
+				continue;
+			}
 
+			Vertex_PosColOut triangle[3]{ vertices[i0], vertices[i1], vertices[i2] };
+			triangle[0].Pos = clipPositions[i0];
+			triangle[1].Pos = clipPositions[i1];
+			triangle[2].Pos = clipPositions[i2];
 
+			Vertex_PosColOut polygon[Rasterizer::MaxClippedVertices]{};
+			const int nrVertices{ Rasterizer::ClipTriangle(triangle, clipPlanes, polygon) };
+			for (int v{}; v < nrVertices; ++v)
+			{
+				polygon[v].Pos = PerspectiveDivide(polygon[v].Pos);
+			}
 
+			//Fan triangulation keeps the winding of the original triangle
+			for (int v{ 2 }; v < nrVertices; ++v)
+			{
+				ClippedTriangle clipped{ { polygon[0], polygon[v - 1], polygon[v] } };
+				if (!Rasterizer::SetupTriangle(clipped.vertices[0].Pos, clipped.vertices[1].Pos, clipped.vertices[2].Pos, clipped.setup, cull))
+					continue;
 
-	void dae::Renderer::RenderTriangle(std::vector<Vertex_PosColOut>& newTriangle) const
+				clippedTriangles.push_back(clipped);
+				BinTriangle(chunkBins, static_cast<uint32_t>(clippedTriangles.size() - 1) | m_ClippedBit, clipped.setup);
+			}
+		}
+	}
+
+	void Renderer::BinTriangle(std::vector<std::vector<uint32_t>>::iterator chunkBins, uint32_t binEntry, const Rasterizer::TriangleSetup& setup) const
 	{
+		//Triangles inside the guard band can still be completely off screen
+		if (setup.maxX <= 0 || setup.maxY <= 0 || setup.minX >= static_cast<int>(m_Width) || setup.minY >= static_cast<int>(m_Height))
+			return;
 
-		Vector2 a = Vector2{ newTriangle[1].Pos.x,newTriangle[1].Pos.y } - Vector2{ newTriangle[0].Pos.x,newTriangle[0].Pos.y };
-		Vector2 b = Vector2{ newTriangle[2].Pos.x,newTriangle[2].Pos.y } - Vector2{ newTriangle[1].Pos.x,newTriangle[1].Pos.y };
-		Vector2 c = Vector2{ newTriangle[0].Pos.x,newTriangle[0].Pos.y } - Vector2{ newTriangle[2].Pos.x,newTriangle[2].Pos.y };
+		//Overlapped tiles
+		const int minTileX{ std::max(setup.minX, 0) / m_TileSize };
+		const int minTileY{ std::max(setup.minY, 0) / m_TileSize };
+		const int maxTileX{ std::min((setup.maxX - 1) / m_TileSize, m_NrTilesX - 1) };
+		const int maxTileY{ std::min((setup.maxY - 1) / m_TileSize, m_NrTilesY - 1) };
 
-		Vector2 triangleV1 = { newTriangle[0].Pos.x,newTriangle[0].Pos.y };
-		Vector2 triangleV2 = { newTriangle[1].Pos.x,newTriangle[1].Pos.y };
-		Vector2 triangleV3 = { newTriangle[2].Pos.x,newTriangle[2].Pos.y };
+		for (int ty{ minTileY }; ty <= maxTileY; ++ty)
+		{
+			for (int tx{ minTileX }; tx <= maxTileX; ++tx)
+			{
+				chunkBins[tx + ty * m_NrTilesX].push_back(binEntry);
+			}
+		}
+	}
+
+	void Renderer::RenderTile(uint32_t tileIndex)
+	{
+		const size_t nrTiles{ m_Tiles.size() };
 
-		Vector2 edge = Vector2{ newTriangle[2].Pos.x,newTriangle[2].Pos.y } - Vector2{ newTriangle[0].Pos.x,newTriangle[0].Pos.y };
-		float totalArea = Vector2::Cross(a, edge);
+		bool hasTriangles{ false };
+		for (uint32_t chunk{}; chunk < m_NrBinChunks; ++chunk)
+		{
+			hasTriangles |= !m_TileBins[chunk * nrTiles + tileIndex].empty();
+		}
+		if (!hasTriangles)
+			return;
 
-		//BoundingBox
-		float minX = std::min(std::min(triangleV1.x, triangleV2.x), triangleV3.x);
-		float minY = std::min(std::min(triangleV1.y, triangleV2.y), triangleV3.y);
-		float maxX = std::max(std::max(triangleV1.x, triangleV2.x), triangleV3.x);
-		float maxY = std::max(std::max(triangleV1.y, triangleV2.y), triangleV3.y);
+		ClearTile(tileIndex);
 
-		if (
-			((minX >= 0) && (maxX <= (m_Width - 1))) &&
-			((minY >= 0) && (maxY <= (m_Height - 1)))) {
-			for (int px{ static_cast<int>(minX) }; px < std::ceil(maxX); ++px)
+		for (uint32_t chunk{}; chunk < m_NrBinChunks; ++chunk)
+		{
+			for (uint32_t binEntry : m_TileBins[chunk * nrTiles + tileIndex])
 			{
-				for (int py{ static_cast<int>(minY) }; py < std::ceil(maxY); ++py)
-				{
-					float gradient = px / static_cast<float>(m_Width);
-					gradient += py / static_cast<float>(m_Width);
-					gradient /= 2.0f;
+				const uint32_t triangleId{ ToTriangleId(chunk, binEntry) };
+				const Vertex_PosColOut* triangle[3]{};
+				const Rasterizer::TriangleSetup& setup{ GetTriangle(triangleId, triangle) };
+				RenderTriangle(triangle, setup, tileIndex, triangleId);
+			}
+		}
+	}
 
+	void Renderer::ClearTile(uint32_t tileIndex)
+	{
+		const Tile& tile{ m_Tiles[tileIndex] };
+		const int width{ tile.maxX - tile.minX };
 
-					Vector2 p{ float(px),float(py) };
+		//One pass over the tile writes every buffer while its rows are in the cache anyway
+		for (int py{ tile.minY }; py < tile.maxY; ++py)
+		{
+			const int rowPixel{ tile.minX + (py * m_Width) };
+			std::fill_n(&m_pDepthBufferPixels[rowPixel], width, FLT_MAX);
+			std::fill_n(&m_ColorBuffer[rowPixel], width, m_ClearColor);
+			if (m_IsUsingVisibilityBuffer)
+			{
+				std::fill_n(&m_pTriangleIdBuffer[rowPixel], width, m_InvalidTriangleId);
+			}
+		}
 
-					Vector2 pointToSide{ p - triangleV2 };
-					float signedArea1{ Vector2::Cross(b, pointToSide) };
+		ClearHiZ(tileIndex);
+		m_TileIsCleared[tileIndex] = 0;
+	}
 
-					pointToSide = p - triangleV3;
-					float signedArea2{ Vector2::Cross(c, pointToSide) };
+	void Renderer::ResolveTile(uint32_t tileIndex) const
+	{
+		const Tile& tile{ m_Tiles[tileIndex] };
+		if (!m_TileIsCleared[tileIndex])
+		{
+			for (int py{ tile.minY }; py < tile.maxY; ++py)
+			{
+				const int rowPixel{ tile.minX + (py * m_Width) };
+				m_ResolveFunction(&m_ColorBuffer[rowPixel], &m_pBackBufferPixels[rowPixel], tile.maxX - tile.minX, m_PixelFormat);
+			}
+			return;
+		}
 
-					pointToSide = p - triangleV1;
-					float signedArea3{ Vector2::Cross(a, pointToSide) };
+		//Nothing was drawn, the back buffer is not read again before the blit so bypass the cache
+		for (int py{ tile.minY }; py < tile.maxY; ++py)
+		{
+			Rasterizer::StreamFill(&m_pBackBufferPixels[tile.minX + (py * m_Width)], tile.maxX - tile.minX, m_ClearPixel);
+		}
+		Rasterizer::StreamFence();
+	}
 
-					float W1 = signedArea1 / totalArea;
-					float W2 = signedArea2 / totalArea;
-					float W3 = signedArea3 / totalArea;
-				
+	void Renderer::ClearHiZ(uint32_t tileIndex) const
+	{
+		const Tile& tile{ m_Tiles[tileIndex] };
+		const int nrBlocksX{ (tile.maxX - tile.minX + Rasterizer::SpanWidth - 1) / Rasterizer::SpanWidth };
+		const int nrBlocksY{ (tile.maxY - tile.minY + Rasterizer::SpanWidth - 1) / Rasterizer::SpanWidth };
 
-					int curPixel = px + (py * m_Width);
-					ColorRGB finalColor{};
-					
-					if(m_IsShowingBoundingBox)
-					{
-						m_ColorBuffer[curPixel] = ColorRGB{ 1,1,1 };
-					} else
-					if (W1 > 0.f && W2 > 0.f && W3 > 0.f) {
+		float* pBlocks{ &m_pHiZBlocks[tileIndex * m_HiZBlocksPerTile] };
+		for (int block{}; block < m_HiZBlocksPerTile; ++block)
+		{
+			const bool isOnScreen{ block % m_HiZBlocksPerRow < nrBlocksX && block / m_HiZBlocksPerRow < nrBlocksY };
+			pBlocks[block] = isOnScreen ? FLT_MAX : -FLT_MAX;
+		}
+		m_pHiZTiles[tileIndex] = FLT_MAX;
+	}
 
-						//CullingTest
-						switch(m_RasterState)
-						{
-						case RasterState::Back:
-							if (Vector3::Dot(newTriangle[0].Normal.Normalized(), newTriangle[0].viewDirection.Normalized()) < 0)
-							{
-								return;
-							}
-							break;
-						case RasterState::Front:
-							if (Vector3::Dot(newTriangle[0].Normal.Normalized(), newTriangle[0].viewDirection.Normalized()) > 0)
-							{
-								return;
-							}
-							break;
-							default:
-								break;
-						}
+	float Renderer::GetFarthestDepth(int minX, int minY, int maxX, int maxY) const
+	{
+		float farthest{ -FLT_MAX };
+		for (int py{ minY }; py < maxY; ++py)
+		{
+			const float* pRow{ &m_pDepthBufferPixels[py * m_Width] };
+			for (int px{ minX }; px < maxX; ++px)
+			{
+				farthest = std::max(farthest, pRow[px]);
+			}
+		}
+		return farthest;
+	}
 
-					
+	uint32_t Renderer::ToTriangleId(uint32_t chunk, uint32_t binEntry) const
+	{
+		if ((binEntry & m_ClippedBit) == 0)
+			return binEntry;
+		return m_ClippedBit | (m_ClippedTriangleOffsets[chunk] + (binEntry & ~m_ClippedBit));
+	}
 
-						//depth test
-						float interpolatedDepth{ 1 / ((1 / newTriangle[0].Pos.z) * W1 + (1 / newTriangle[1].Pos.z) * W2 + (1 / newTriangle[2].Pos.z) * W3) };
-						if (interpolatedDepth > m_pDepthBufferPixels[curPixel]) {
-							continue;
-						}
-						m_pDepthBufferPixels[curPixel] = interpolatedDepth;
+	const Rasterizer::TriangleSetup& Renderer::GetTriangle(uint32_t triangleId, const Vertex_PosColOut* triangle[3]) const
+	{
+		if ((triangleId & m_ClippedBit) == 0)
+		{
+			const std::span<const uint32_t> indices{ m_pVehicleMesh->m_Indices };
+			const std::vector<Vertex_PosColOut>& vertices{ m_pVehicleMesh->vertices_out };
+			const size_t i{ size_t(triangleId) * 3 };
+			triangle[0] = &vertices[indices[i]];
+			triangle[1] = &vertices[indices[i + 1]];
+			triangle[2] = &vertices[indices[i + 2]];
+			return m_TriangleSetups[triangleId];
+		}
 
+		//Clipped triangles are rare, find the chunk that made it
+		const uint32_t index{ triangleId & ~m_ClippedBit };
+		const size_t chunk{ size_t(std::upper_bound(m_ClippedTriangleOffsets.begin(), m_ClippedTriangleOffsets.end(), index) - m_ClippedTriangleOffsets.begin()) - 1 };
+		const ClippedTriangle& clipped{ m_ClippedTriangles[chunk][index - m_ClippedTriangleOffsets[chunk]] };
+		triangle[0] = &clipped.vertices[0];
+		triangle[1] = &clipped.vertices[1];
+		triangle[2] = &clipped.vertices[2];
+		return clipped.setup;
+	}
 
+	void Renderer::ShadeTile(uint32_t tileIndex) const
+	{
+		using Rasterizer::SpanWidth;
+		const Tile& tile{ m_Tiles[tileIndex] };
 
-						//Deciding color
-						float interpolatedDepthW{ 1 / ((1 / newTriangle[0].Pos.w) * W1 + (1 / newTriangle[1].Pos.w) * W2 + (1 / newTriangle[2].Pos.w) * W3) };
+		//Neighbouring spans mostly show the same triangle, so the span setup of the last one is kept
+		uint32_t setupId{ m_InvalidTriangleId };
+		const Rasterizer::TriangleSetup* pSetup{ nullptr };
+		Rasterizer::SpanSetup spanSetup{};
+		Rasterizer::Span span{};
 
-						Vector2 interpolatedUV{
-							(((newTriangle[0].Uv / newTriangle[0].Pos.w) * W1) +
-							((newTriangle[1].Uv / newTriangle[1].Pos.w) * W2) +
-							((newTriangle[2].Uv / newTriangle[2].Pos.w) * W3)) * interpolatedDepthW };
+		for (int py{ tile.minY }; py < tile.maxY; ++py)
+		{
+			for (int px{ tile.minX }; px < tile.maxX; px += SpanWidth)
+			{
+				const int spanPixel{ px + (py * m_Width) };
+				const int nrPixels{ std::min(SpanWidth, tile.maxX - px) };
+				const uint32_t* pIds{ &m_pTriangleIdBuffer[spanPixel] };
 
-						//normal interpolating
-						Vector3 interpolatedNormal{
-							(((newTriangle[0].Normal / newTriangle[0].Pos.w) * W1) +
-							((newTriangle[1].Normal / newTriangle[1].Pos.w) * W2) +
-							((newTriangle[2].Normal / newTriangle[2].Pos.w) * W3)) * interpolatedDepthW };
+				uint32_t remaining{};
+				for (int i{}; i < nrPixels; ++i)
+				{
+					if (pIds[i] != m_InvalidTriangleId)
+						remaining |= 1u << i;
+				}
 
-						//tangent interpolating
-						Vector3 interpolatedTangent{
-							(((newTriangle[0].Tangent / newTriangle[0].Pos.w) * W1) +
-							((newTriangle[1].Tangent / newTriangle[1].Pos.w) * W2) +
-							((newTriangle[2].Tangent / newTriangle[2].Pos.w) * W3)) * interpolatedDepthW };
+				//Interpolate the span once for every triangle visible in it
+				while (remaining != 0)
+				{
+					const uint32_t triangleId{ pIds[std::countr_zero(remaining)] };
+					uint32_t triangleMask{};
+					for (uint32_t mask{ remaining }; mask != 0; mask &= mask - 1)
+					{
+						const int lane{ std::countr_zero(mask) };
+						if (pIds[lane] == triangleId)
+							triangleMask |= 1u << lane;
+					}
+					remaining &= ~triangleMask;
 
+					if (triangleId != setupId)
+					{
+						const Vertex_PosColOut* triangle[3]{};
+						pSetup = &GetTriangle(triangleId, triangle);
+						Rasterizer::SetupSpan(triangle, *pSetup, spanSetup);
+						setupId = triangleId;
+					}
 
-					
-						ColorRGB interpolatedColor{ m_pTexture->Sample(interpolatedUV) };
+					//Against a depth that always passes the covered span function gives back the depth the raster pass stored
+					const int64_t edges[3]{ pSetup->edges[0].At(px, py), pSetup->edges[1].At(px, py), pSetup->edges[2].At(px, py) };
+					float depth[SpanWidth]{};
+					std::fill(std::begin(depth), std::end(depth), FLT_MAX);
+					m_SpanFunctions.covered(spanSetup, edges, px, py, depth, span);
 
-						//pos interpolated
-						Vector4 interpolatedPos{
-							((newTriangle[0].Pos * W1) +
-							(newTriangle[1].Pos * W2) +
-							(newTriangle[2].Pos * W3)) * interpolatedDepthW
-						};
+					span.mask &= triangleMask;
+					ShadeSpan(span, spanSetup, px, py);
+				}
+			}
+		}
+	}
 
-						//interpolatedViewDirection;
-						Vector3 interpolatedViewDir
-						{
-							(((newTriangle[0].viewDirection / newTriangle[0].Pos.w) * W1) +
-							((newTriangle[1].viewDirection / newTriangle[1].Pos.w) * W2) +
-							((newTriangle[2].viewDirection / newTriangle[2].Pos.w) * W3)) * interpolatedDepthW
-						};
-					
-						Vector3 binormal = Vector3::Cross(interpolatedNormal, interpolatedTangent);
-						Matrix tangentSpaceAxis = Matrix{ interpolatedTangent,binormal,interpolatedNormal,Vector3::Zero };
-						
+	void Renderer::RenderTriangle(const Vertex_PosColOut* const newTriangle[3], const Rasterizer::TriangleSetup& setup, uint32_t tileIndex, uint32_t triangleId) const
+	{
+		using Rasterizer::SpanWidth;
+		const Tile& tile{ m_Tiles[tileIndex] };
+
+		//Clip the BoundingBox to the tile
+		const int startX{ std::max(setup.minX, tile.minX) };
+		const int startY{ std::max(setup.minY, tile.minY) };
+		const int endX{ std::min(setup.maxX, tile.maxX) };
+		const int endY{ std::min(setup.maxY, tile.maxY) };
+		if (startX >= endX || startY >= endY)
+			return;
 
+		if (m_IsShowingBoundingBox)
+		{
+			for (int py{ startY }; py < endY; ++py)
+			{
+				for (int px{ startX }; px < endX; ++px)
+				{
+					m_ColorBuffer[px + (py * m_Width)] = ColorRGB{ 1,1,1 };
+				}
+			}
+			return;
+		}
 
-						ColorRGB interpolatedNormalMap{ m_pTextureNormal->Sample(interpolatedUV) };
-						Vector3 normalVec{ interpolatedNormalMap.r,interpolatedNormalMap.g,interpolatedNormalMap.b };
-						//multiply with matrix
-						normalVec = { 2.f * normalVec.x - 1.f, 2.f * normalVec.y - 1.f, 2.f * normalVec.z - 1.f };
-						normalVec = tangentSpaceAxis.TransformVector(normalVec);
-						normalVec /= 255.f;
-					
+		//Hierarchical Z, the interpolated depth never gets closer than the closest vertex. The slack covers the
+		//rounding of the depth plane equation so a rejected triangle could not have passed a single depth test
+		constexpr float depthSlack{ 0.9999f };
+		const float closestDepth{ std::min(std::min(newTriangle[0]->Pos.z, newTriangle[1]->Pos.z), newTriangle[2]->Pos.z) * depthSlack };
+		if (closestDepth > m_pHiZTiles[tileIndex])
+			return;
+		float* pHiZBlocks{ &m_pHiZBlocks[tileIndex * m_HiZBlocksPerTile] };
+		bool isHiZChanged{ false };
+
+		Rasterizer::SpanSetup spanSetup{};
+		Rasterizer::SetupSpan(newTriangle, setup, spanSetup);
+
+		//Blocks of SpanWidth x SpanWidth pixels are classified against the edges first, tiles are a multiple of
+		//SpanWidth wide so a block never crosses into another tile
+		constexpr int blockSize{ SpanWidth };
+		const int blockStartX{ startX & ~(blockSize - 1) };
+		const int blockStartY{ startY & ~(blockSize - 1) };
+
+		const Rasterizer::Edge* edges{ setup.edges };
+		int64_t stepY[3]{};
+		int64_t blockStepX[3]{};
+		int64_t blockStepY[3]{};
+		int64_t blockMin[3]{}; //smallest value of the edge inside a block, relative to the block's first pixel
+		int64_t blockMax[3]{}; //largest value
+		int64_t blockRowEdges[3]{};
+		for (int k{}; k < 3; ++k)
+		{
+			stepY[k] = edges[k].StepY();
+			blockStepX[k] = edges[k].StepX() * blockSize;
+			blockStepY[k] = stepY[k] * blockSize;
 
+			const int64_t acrossX{ edges[k].StepX() * (blockSize - 1) };
+			const int64_t acrossY{ stepY[k] * (blockSize - 1) };
+			blockMin[k] = std::min(acrossX, int64_t(0)) + std::min(acrossY, int64_t(0));
+			blockMax[k] = std::max(acrossX, int64_t(0)) + std::max(acrossY, int64_t(0));
 
-						Vertex_PosColOut interpolatedV = { interpolatedPos,Vector3(interpolatedColor.r,interpolatedColor.g,interpolatedColor.b),interpolatedUV,m_HasNormalMap ? normalVec.Normalized() : interpolatedNormal,interpolatedTangent,interpolatedViewDir };
+			blockRowEdges[k] = edges[k].At(blockStartX, blockStartY);
+		}
 
+		Rasterizer::Span span{};
+		for (int by{ blockStartY }; by < endY; by += blockSize)
+		{
+			int64_t blockEdges[3]{ blockRowEdges[0], blockRowEdges[1], blockRowEdges[2] };
+			for (int bx{ blockStartX }; bx < endX; bx += blockSize)
+			{
+				bool isOutside{ false };
+				bool isCovered{ true };
+				for (int k{}; k < 3; ++k)
+				{
+					isOutside |= blockEdges[k] + blockMax[k] < 0;
+					isCovered &= blockEdges[k] + blockMin[k] >= 0;
+				}
 
-						//Get Specular and gloss from maps
-						ColorRGB glos = m_pTextureGloss->Sample(interpolatedUV);
-						ColorRGB spec = m_pTextureSpecular->Sample(interpolatedUV);
-						Vector3 glosVec{ glos.r,glos.g,glos.b };
-						Vector3 specVec{ spec.r,spec.g,spec.b };
+				float& blockDepth{ pHiZBlocks[((by - tile.minY) / blockSize) * m_HiZBlocksPerRow + (bx - tile.minX) / blockSize] };
+				if (!isOutside && closestDepth <= blockDepth)
+				{
+					uint32_t writtenMask{};
+					Rasterizer::SpanFunction spanFunction{ isCovered ? m_SpanFunctions.covered : m_SpanFunctions.partial };
+					if (m_IsUsingVisibilityBuffer)
+					{
+						spanFunction = isCovered ? m_SpanFunctions.coveredDepthOnly : m_SpanFunctions.partialDepthOnly;
+					}
+					const int nrPixels{ std::min(SpanWidth, tile.maxX - bx) };
+					const int firstRow{ std::max(by, startY) };
+					const int lastRow{ std::min(by + blockSize, endY) };
 
+					int64_t spanEdges[3]{};
+					for (int k{}; k < 3; ++k)
+					{
+						spanEdges[k] = blockEdges[k] + stepY[k] * (firstRow - by);
+					}
 
-					
-						m_ColorBuffer[curPixel] = PixelShading(interpolatedV, specVec.x , glosVec.x );
+					for (int py{ firstRow }; py < lastRow; ++py)
+					{
+						const int spanPixel{ bx + (py * m_Width) };
+						if (nrPixels == SpanWidth)
+						{
+							spanFunction(spanSetup, spanEdges, bx, py, &m_pDepthBufferPixels[spanPixel], span);
+						}
+						else
+						{
+							//Right screen border, pad so the span function never touches pixels outside the buffer
+							float depth[SpanWidth]{};
+							std::fill(std::begin(depth), std::end(depth), -FLT_MAX);
+							std::copy_n(&m_pDepthBufferPixels[spanPixel], nrPixels, depth);
+							spanFunction(spanSetup, spanEdges, bx, py, depth, span);
+							std::copy_n(depth, nrPixels, &m_pDepthBufferPixels[spanPixel]);
+						}
 
-						if(m_IsShowingDepth)
+						writtenMask |= span.mask;
+						if (m_IsUsingVisibilityBuffer)
 						{
-							float d = static_cast<float>((2.0 * m_pCamera->nearPlane) / (m_pCamera->farPlane + m_pCamera->nearPlane - interpolatedDepth * (m_pCamera->farPlane - m_pCamera->nearPlane)));
-							m_ColorBuffer[curPixel] = ColorRGB{ d,d,d };
+							for (uint32_t mask{ span.mask }; mask != 0; mask &= mask - 1)
+							{
+								m_pTriangleIdBuffer[spanPixel + std::countr_zero(mask)] = triangleId;
+							}
+						}
+						else
+						{
+							ShadeSpan(span, spanSetup, bx, py);
 						}
-					}
 
-					finalColor = m_ColorBuffer[curPixel];
-					//Update Color in Buffer
-					finalColor.MaxToOne();
+						spanEdges[0] += stepY[0];
+						spanEdges[1] += stepY[1];
+						spanEdges[2] += stepY[2];
+					}
 
-					m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-						static_cast<uint8_t>(finalColor.r * 255),
-						static_cast<uint8_t>(finalColor.g * 255),
-						static_cast<uint8_t>(finalColor.b * 255));
+					if (writtenMask != 0)
+					{
+						blockDepth = GetFarthestDepth(bx, by, bx + nrPixels, std::min(by + blockSize, tile.maxY));
+						isHiZChanged = true;
+					}
 				}
+
+				blockEdges[0] += blockStepX[0];
+				blockEdges[1] += blockStepX[1];
+				blockEdges[2] += blockStepX[2];
 			}
-		} 
+
+			blockRowEdges[0] += blockStepY[0];
+			blockRowEdges[1] += blockStepY[1];
+			blockRowEdges[2] += blockStepY[2];
+		}
+
+		if (isHiZChanged)
+		{
+			m_pHiZTiles[tileIndex] = *std::max_element(pHiZBlocks, pHiZBlocks + m_HiZBlocksPerTile);
+		}
 	}
 
-	void Renderer::VertexTransformationFunction(const std::vector<Vertex_PosCol>& vertices_in, std::vector<Vertex_PosColOut>& vertices_out, Matrix worldMatrix) const
+	void Renderer::ShadeSpan(const Rasterizer::Span& span, const Rasterizer::SpanSetup& spanSetup, int px, int py) const
 	{
-		vertices_out.clear();
-		float aspectRatio = { m_Width / static_cast<float>(m_Height) };
-		Matrix end = worldMatrix * m_pCamera->viewMatrix * m_pCamera->projectionMatrix;
-		for (int i{}; i < vertices_in.size(); i++)
+		if (span.mask == 0)
+			return;
+
+		Rasterizer::SpanDerivatives derivatives{};
+		Rasterizer::ComputeQuadDerivatives(spanSetup, px, py, derivatives);
+
+		const int spanPixel{ px + (py * m_Width) };
+		for (uint32_t mask{ span.mask }; mask != 0; mask &= mask - 1)
 		{
-			Vertex_PosCol pWorld{};
-			Vertex_PosColOut p{};
-			//To view Space
-		
-			pWorld = vertices_in[i];
-			Vector4 pos{ pWorld.Pos.x,pWorld.Pos.y,pWorld.Pos.z,1 };
-			Vertex_PosColOut pView{};
+			const int lane{ std::countr_zero(mask) };
+
+			Vertex_PosColOut interpolated{};
+			interpolated.Pos = {
+				span.attributes[Rasterizer::AttrPosX][lane], span.attributes[Rasterizer::AttrPosY][lane],
+				span.attributes[Rasterizer::AttrPosZ][lane], span.attributes[Rasterizer::AttrPosW][lane] };
+			interpolated.Uv = { span.attributes[Rasterizer::AttrU][lane], span.attributes[Rasterizer::AttrV][lane] };
+			interpolated.Normal = {
+				span.attributes[Rasterizer::AttrNormalX][lane], span.attributes[Rasterizer::AttrNormalY][lane], span.attributes[Rasterizer::AttrNormalZ][lane] };
+			interpolated.Tangent = {
+				span.attributes[Rasterizer::AttrTangentX][lane], span.attributes[Rasterizer::AttrTangentY][lane], span.attributes[Rasterizer::AttrTangentZ][lane] };
+			interpolated.viewDirection = {
+				span.attributes[Rasterizer::AttrViewX][lane], span.attributes[Rasterizer::AttrViewY][lane], span.attributes[Rasterizer::AttrViewZ][lane] };
+
+			const Vector2 uvDdx{ derivatives.dUdx[lane], derivatives.dVdx[lane] };
+			const Vector2 uvDdy{ derivatives.dUdy[lane], derivatives.dVdy[lane] };
+			m_ColorBuffer[spanPixel + lane] = ShadePixel(interpolated, span.depth[lane], uvDdx, uvDdy);
+		}
+	}
+
+	ColorRGB Renderer::ShadePixel(const Vertex_PosColOut& interpolated, float interpolatedDepth, const Vector2& uvDdx, const Vector2& uvDdy) const
+	{
+		const Vector2& interpolatedUV{ interpolated.Uv };
+		const Vector3& interpolatedNormal{ interpolated.Normal };
+		const Vector3& interpolatedTangent{ interpolated.Tangent };
+
+		if(m_IsShowingDepth)
+		{
+			float d = static_cast<float>((2.0 * m_pCamera->nearPlane) / (m_pCamera->farPlane + m_pCamera->nearPlane - interpolatedDepth * (m_pCamera->farPlane - m_pCamera->nearPlane)));
+			return ColorRGB{ d,d,d };
+		}
 
-			pView.Pos = end.TransformPoint(pos);
+		//Every map in two fetches
+		const MaterialSample material{ m_pVehicleMaterial->Sample(interpolatedUV, uvDdx, uvDdy, m_TextureFilter, m_MaxAnisotropy) };
+		const ColorRGB& interpolatedColor{ material.diffuse };
 
+		Vector3 binormal = Vector3::Cross(interpolatedNormal, interpolatedTangent);
+		Matrix tangentSpaceAxis = Matrix{ interpolatedTangent,binormal,interpolatedNormal,Vector3::Zero };
 
-			//Perspective Divide
-			p.Pos.x = pView.Pos.x / pView.Pos.w;
-			p.Pos.y = pView.Pos.y / pView.Pos.w;
-			p.Pos.z = pView.Pos.z / pView.Pos.w;
-			p.Pos.w = pView.Pos.w;
+		//multiply with matrix
+		const Vector3 normalVec{ tangentSpaceAxis.TransformVector(material.normal) };
 
-		
-			p.Pos.x = ((p.Pos.x + 1) / 2) * m_Width;
-			p.Pos.y = ((1 - p.Pos.y) / 2) * m_Height;
-			p.Color = vertices_in[i].Color;
-			p.Uv = vertices_in[i].Uv;
-		
+		Vertex_PosColOut interpolatedV = { interpolated.Pos,Vector3(interpolatedColor.r,interpolatedColor.g,interpolatedColor.b),interpolatedUV,m_HasNormalMap ? normalVec.Normalized() : interpolatedNormal,interpolatedTangent,interpolated.viewDirection };
 
-			p.Normal = worldMatrix.TransformVector(vertices_in[i].Normal);
-			p.Tangent = worldMatrix.TransformVector(vertices_in[i].Tangent);
+		return PixelShading(interpolatedV, material.specular, material.gloss);
+	}
 
-			//calculateViewDirectionToo
-			p.viewDirection = Vector3{ m_pCamera->origin - pView.Pos };
-			vertices_out.push_back(p);
-		}
+	Vector4 Renderer::PerspectiveDivide(const Vector4& clipPos) const
+	{
+		//Perspective Divide, x and y to screen space, w is kept for perspective correct interpolation
+		Vector4 p{ clipPos.x / clipPos.w, clipPos.y / clipPos.w, clipPos.z / clipPos.w, clipPos.w };
+		p.x = ((p.x + 1) / 2) * m_Width;
+		p.y = ((1 - p.y) / 2) * m_Height;
+		return p;
 	}
 
 
@@ -5,6 +5,12 @@ struct SDL_Surface;
 #include "Mesh.h"
 #include "Camera.h"
 #include "Texture.h"
+#include "MaterialTexture.h"
+#include "MeshAsset.h"
+#include "ThreadPool.h"
+#include "RasterizerSIMD.h"
+#include "Clipper.h"
+#include "Framebuffer.h"
 namespace dae
 {
     enum class ShadingMode {
@@ -24,6 +30,7 @@ namespace dae
     enum class SamplerState
     {
         Point,
+        Bilinear,
 	    Linear,
         Anisotropic
 
@@ -41,7 +48,7 @@ namespace dae
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
 		void Update(const Timer* pTimer);
-		void Render() const;
+		void Render();
         void CycleTecnhique();
         void CylceShadingMode();
         void ToggleRotation();
@@ -52,6 +59,7 @@ namespace dae
         void ToggleUniformColor();
         void ToggleDepthShow();
         void ToggleBoundingBoxShow();
+        void ToggleVisibilityBuffer();
 	private:
         SDL_Window* m_pWindow{};
         HANDLE m_Handle;
@@ -66,9 +74,12 @@ namespace dae
         bool m_IsShowingDepth{};
         bool m_IsUniformColor{};
         bool m_IsShowingBoundingBox{};
+        bool m_IsUsingVisibilityBuffer{};
 
         ShadingMode m_ShadingMode{};
         SamplerState m_SamplerState{};
+        TextureFilter m_TextureFilter{ TextureFilter::Point }; //software filter of m_SamplerState
+        static constexpr int m_MaxAnisotropy{ 8 }; //of both anisotropic samplers, D3D allows 1 to 16
         RasterState m_RasterState{};
         Camera* m_pCamera{ nullptr };
 
@@ -90,16 +101,20 @@ namespace dae
         ID3D11RasterizerState* m_pBackCullState{ nullptr };
 
         ID3D11SamplerState* m_pPointSample{ nullptr };
+        ID3D11SamplerState* m_pBilinearSample{ nullptr };
         ID3D11SamplerState* m_pLinearSample{ nullptr };
         ID3D11SamplerState* m_pAnisotropicSample{ nullptr };
 
 
         Mesh* m_pCombustionMesh{ nullptr };
         Mesh* m_pVehicleMesh{ nullptr };
+        //Software vertex stream of the vehicle, Compact reads 18 instead of 56 bytes a vertex
+        static constexpr Rasterizer::VertexFormat m_VehicleVertexFormat{ Rasterizer::VertexFormat::Compact };
         Texture* m_pTexture{ nullptr };
         Texture* m_pTextureGloss{ nullptr };
         Texture* m_pTextureNormal{ nullptr };
         Texture* m_pTextureSpecular{ nullptr };
+        MaterialTexture* m_pVehicleMaterial{ nullptr }; //the four maps above packed for the software rasterizer
 
         Texture* m_pTextureFire{ nullptr };
 
@@ -108,6 +123,8 @@ namespace dae
         Matrix m_ScaleMatrix{};
 
         void ShowKeybindings() const;
+        //Through the binary cache of the OBJ, only the first launch after the OBJ changes parses it
+        Mesh* LoadMesh(const std::string& objPath, Utils::MeshOrder order, Rasterizer::VertexFormat format = Rasterizer::VertexFormat::Float) const;
 
 		//DIRECTX
 		HRESULT InitializeDirectX();
@@ -119,14 +136,86 @@ namespace dae
 
         SDL_Surface* m_pFrontBuffer{ nullptr };
         SDL_Surface* m_pBackBuffer{ nullptr };
-        uint32_t* m_pBackBufferPixels{};
+        uint32_t* m_pBackBufferPixels{}; //pixels of m_pPresentSurface, valid while it is locked
+
+        //Tiles are resolved straight into the window surface when it takes 32 bit pixels with 8 bit channels and
+        //no row padding, otherwise into m_pBackBuffer which is blitted to the window
+        SDL_Surface* m_pPresentSurface{ nullptr };
+        bool m_IsPresentingDirectly{};
+        Rasterizer::PixelFormat m_PixelFormat{};
+        Rasterizer::ResolveFunction m_ResolveFunction{ nullptr };
 
         float* m_pDepthBufferPixels{};
         ColorRGB* m_ColorBuffer;
-        void RenderSoftware() const;
-
-        void RenderTriangle(std::vector<Vertex_PosColOut>& newTriangle) const;
-        void VertexTransformationFunction(const std::vector<Vertex_PosCol>& vertices_in, std::vector<Vertex_PosColOut>& vertices_out, Matrix worldMatrix) const; 
+        void RenderSoftware();
+
+        //Tiles, every tile is rasterized by exactly one worker so the buffers need no locking
+        struct Tile
+        {
+            int minX{};
+            int minY{};
+            int maxX{}; //exclusive
+            int maxY{}; //exclusive
+        };
+        static constexpr int m_TileSize{ 64 };
+        int m_NrTilesX{};
+        int m_NrTilesY{};
+        std::vector<Tile> m_Tiles{};
+
+        //Fast clear, a frame only records the clear values. A tile writes them when it is first drawn to, tiles that
+        //stay cleared stream the clear pixel into the back buffer when they are resolved, the others convert their
+        //colors once after the last triangle
+        ColorRGB m_ClearColor{};
+        uint32_t m_ClearPixel{};
+        std::vector<uint8_t> m_TileIsCleared{}; //[tile]
+        void ClearTile(uint32_t tileIndex);
+        void ResolveTile(uint32_t tileIndex) const;
+
+        //Binning, triangles are split in one contiguous chunk per worker and each chunk has its own bins,
+        //rasterizing a tile walks the chunks in order so triangles are still drawn in submission order
+        ThreadPool* m_pThreadPool{ nullptr };
+        uint32_t m_NrBinChunks{};
+        std::vector<std::vector<uint32_t>> m_TileBins{}; //[chunk * nrTiles + tile]
+        std::vector<Rasterizer::TriangleSetup> m_TriangleSetups{}; //one per triangle
+
+        //Triangles made by the clipper, bin entries with m_ClippedBit set index the list of their chunk
+        struct ClippedTriangle
+        {
+            Vertex_PosColOut vertices[3]{};
+            Rasterizer::TriangleSetup setup{};
+        };
+        static constexpr uint32_t m_ClippedBit{ 0x80000000u };
+        std::vector<std::vector<ClippedTriangle>> m_ClippedTriangles{}; //[chunk]
+
+        void BinTriangles(uint32_t chunk, uint32_t firstTriangle, uint32_t lastTriangle);
+        void BinTriangle(std::vector<std::vector<uint32_t>>::iterator chunkBins, uint32_t binEntry, const Rasterizer::TriangleSetup& setup) const;
+        void RenderTile(uint32_t tileIndex);
+
+        //Hierarchical Z, the farthest depth of every block of SpanWidth x SpanWidth pixels and of every tile. Blocks
+        //outside the screen stay at -FLT_MAX so they never keep a tile from rejecting triangles
+        static constexpr int m_HiZBlocksPerRow{ m_TileSize / Rasterizer::SpanWidth };
+        static constexpr int m_HiZBlocksPerTile{ m_HiZBlocksPerRow * m_HiZBlocksPerRow };
+        float* m_pHiZBlocks{}; //[tile * m_HiZBlocksPerTile + block]
+        float* m_pHiZTiles{}; //[tile]
+        void ClearHiZ(uint32_t tileIndex) const;
+        float GetFarthestDepth(int minX, int minY, int maxX, int maxY) const;
+
+        //Visibility buffer, the raster pass only writes depth and the id of the visible triangle, shading runs once
+        //per pixel afterwards. Ids of clipped triangles are m_ClippedBit | (chunk offset + index in the chunk)
+        static constexpr uint32_t m_InvalidTriangleId{ 0xFFFFFFFFu };
+        uint32_t* m_pTriangleIdBuffer{};
+        std::vector<uint32_t> m_ClippedTriangleOffsets{}; //[chunk]
+        uint32_t ToTriangleId(uint32_t chunk, uint32_t binEntry) const;
+        const Rasterizer::TriangleSetup& GetTriangle(uint32_t triangleId, const Vertex_PosColOut* triangle[3]) const;
+        void ShadeTile(uint32_t tileIndex) const;
+
+        Rasterizer::VertexTransformFunction m_VertexTransformFunction{ nullptr };
+        Rasterizer::SpanFunctions m_SpanFunctions{};
+        void RenderTriangle(const Vertex_PosColOut* const newTriangle[3], const Rasterizer::TriangleSetup& setup, uint32_t tileIndex, uint32_t triangleId) const;
+        //Shades the passing pixels of the span at (px, py), the uv derivatives come from its 2x2 pixel quads
+        void ShadeSpan(const Rasterizer::Span& span, const Rasterizer::SpanSetup& spanSetup, int px, int py) const;
+        ColorRGB ShadePixel(const Vertex_PosColOut& interpolated, float interpolatedDepth, const Vector2& uvDdx, const Vector2& uvDdy) const;
+        Vector4 PerspectiveDivide(const Vector4& clipPos) const;
         ColorRGB PixelShading(const Vertex_PosColOut& v, float spec, float glos) const;
 
 		//...
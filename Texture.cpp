@@ -4,19 +4,39 @@
 #include <SDL_image.h>
 #include <iostream>
 #include <d3d11.h>
+#include <array>
 
 namespace dae
 {
-	Texture::Texture(SDL_Surface* pSurface, ID3D11Device* pDevice) :
-		m_pSurface{ pSurface },
-		m_pSurfacePixels{ (uint32_t*)pSurface->pixels },
-		m_pDevice{ pDevice }
+	//Byte to [0, 1] float, a texel of a RGBA8 texture is 3 table lookups instead of 3 divides
+	static constexpr std::array<float, 256> MakeByteToFloat()
 	{
+		std::array<float, 256> table{};
+		for (int i{}; i < 256; ++i)
+		{
+			table[i] = static_cast<float>(i) / 255.f;
+		}
+		return table;
+	}
+	static constexpr std::array<float, 256> ByteToFloat{ MakeByteToFloat() };
+
+	//Sides of the blocks of the blocked layouts in texels
+	static constexpr int TiledBlockSize{ 4 };
+	static constexpr int MortonBlockSize{ 16 };
+
+	Texture::Texture(SDL_Surface* pSurface, ID3D11Device* pDevice, TextureStorage storage, TextureLayout layout) :
+		m_pDevice{ pDevice },
+		m_Storage{ storage },
+		m_Layout{ layout }
+	{
+		BuildMipLevels(pSurface);
+		const UINT nrMipLevels{ static_cast<UINT>(m_MipLevels.size()) };
+
 		DXGI_FORMAT format{ DXGI_FORMAT_R8G8B8A8_UNORM };
 		D3D11_TEXTURE2D_DESC desc{};
-		desc.Width = m_pSurface->w;
-		desc.Height = m_pSurface->h;
-		desc.MipLevels = 1;
+		desc.Width = pSurface->w;
+		desc.Height = pSurface->h;
+		desc.MipLevels = nrMipLevels;
 		desc.ArraySize = 1;
 		desc.Format = format;
 		desc.SampleDesc.Count = 1;
@@ -26,68 +46,358 @@ namespace dae
 		desc.CPUAccessFlags = 0;
 		desc.MiscFlags = 0;
 
-		D3D11_SUBRESOURCE_DATA initData{};
-		initData.pSysMem = m_pSurfacePixels;
-		initData.SysMemPitch = static_cast<UINT>(m_pSurface->pitch);
-		initData.SysMemSlicePitch = static_cast<UINT>(m_pSurface->h * m_pSurface->pitch);
+		//Upload the whole chain, the hardware samplers then filter between the same levels as the software one
+		std::vector<D3D11_SUBRESOURCE_DATA> initData(nrMipLevels);
+		for (UINT i{}; i < nrMipLevels; ++i)
+		{
+			const MipLevel& level{ m_MipLevels[i] };
+			initData[i].pSysMem = level.pixels.data();
+			initData[i].SysMemPitch = static_cast<UINT>(level.width * sizeof(uint32_t));
+			initData[i].SysMemSlicePitch = static_cast<UINT>(level.width * level.height * sizeof(uint32_t));
+		}
 
-		HRESULT hr{ pDevice->CreateTexture2D(&desc, &initData, &m_pResource) };
+		HRESULT hr{ pDevice ? pDevice->CreateTexture2D(&desc, initData.data(), &m_pResource) : E_FAIL };
 		if (SUCCEEDED(hr)) {
 
 			D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc{};
 			SRVDesc.Format = format;
 			SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-			SRVDesc.Texture2D.MipLevels = 1;
+			SRVDesc.Texture2D.MipLevels = nrMipLevels;
 
 			hr = m_pDevice->CreateShaderResourceView(m_pResource, &SRVDesc, &m_pSRV);
-			//commented for software
+		}
 
-			/*if (SUCCEEDED(hr)) {
-				SDL_FreeSurface(m_pSurface);
-				m_pSurface = nullptr;
-			}*/
+		//The gpu has its copy, a float texture only keeps the converted texels
+		if (m_Storage == TextureStorage::Float)
+		{
+			for (MipLevel& level : m_MipLevels)
+			{
+				level.colors.resize(level.pixels.size());
+				std::transform(level.pixels.begin(), level.pixels.end(), level.colors.begin(), [](uint32_t texel)
+					{
+						return TexelRGBA{ ByteToFloat[texel & 0xFF], ByteToFloat[(texel >> 8) & 0xFF], ByteToFloat[(texel >> 16) & 0xFF], ByteToFloat[texel >> 24] };
+					});
+				level.pixels = {};
+			}
 		}
+		ApplyLayout();
+
+		using enum TextureStorage;
+		using enum TextureLayout;
+		static constexpr SampleFunction sampleFunctions[2][3]{
+			{ &Texture::SampleFiltered<RGBA8, Linear>, &Texture::SampleFiltered<RGBA8, Tiled>, &Texture::SampleFiltered<RGBA8, Morton> },
+			{ &Texture::SampleFiltered<Float, Linear>, &Texture::SampleFiltered<Float, Tiled>, &Texture::SampleFiltered<Float, Morton> } };
+		m_SampleFunction = sampleFunctions[static_cast<int>(m_Storage)][static_cast<int>(m_Layout)];
 	}
 
 	Texture::~Texture()
 	{
-		if (m_pSurface)
+		if (m_pSRV)
 		{
-			SDL_FreeSurface(m_pSurface);
-			m_pSurface = nullptr;
+			m_pSRV->Release();
+			m_pSRV = nullptr;
 		}
-		m_pSRV->Release();
-		m_pResource->Release();
-		m_pSRV = nullptr;
-		m_pResource = nullptr;
+		if (m_pResource)
+		{
+			m_pResource->Release();
+			m_pResource = nullptr;
+		}
+	}
+
+	Texture* Texture::LoadFromFile(const std::string& path, ID3D11Device* pDevice, TextureStorage storage, TextureLayout layout)
+	{
+		SDL_Surface* pSurface{ LoadSurface(path) };
+
+		//Create & Return a new Texture Object, it copies the pixels into its mip chain
+		Texture* pTexture{ CreateFromSurface(pSurface, pDevice, storage, layout) };
+		SDL_FreeSurface(pSurface);
+		return pTexture;
 	}
 
-	Texture* Texture::LoadFromFile(const std::string& path, ID3D11Device* pDevice)
+	Texture* Texture::CreateFromSurface(SDL_Surface* pSurface, ID3D11Device* pDevice, TextureStorage storage, TextureLayout layout)
+	{
+		return new Texture{ pSurface, pDevice, storage, layout };
+	}
+
+	SDL_Surface* Texture::LoadSurface(const std::string& path)
 	{
 		//Load SDL_Surface using IMG_LOAD
 		SDL_Surface* loadedSurface = IMG_Load(path.c_str());
 
-		//Create & Return a new Texture Object (using SDL_Surface)
-		return new Texture{ loadedSurface, pDevice};
+		//Whatever the file holds, convert to the RGBA byte order of the gpu format
+		SDL_Surface* pConvertedSurface{ SDL_ConvertSurfaceFormat(loadedSurface, SDL_PIXELFORMAT_RGBA32, 0) };
+		SDL_FreeSurface(loadedSurface);
+		return pConvertedSurface;
+	}
+
+	void Texture::BuildMipLevels(SDL_Surface* pSurface)
+	{
+		MipLevel image{ pSurface->w, pSurface->h, pSurface->w };
+		image.pixels.resize(static_cast<size_t>(image.width) * image.height);
+		for (int y{}; y < image.height; ++y)
+		{
+			const uint8_t* pRow{ static_cast<const uint8_t*>(pSurface->pixels) + static_cast<size_t>(y) * pSurface->pitch };
+			std::copy_n(reinterpret_cast<const uint32_t*>(pRow), image.width, &image.pixels[static_cast<size_t>(y) * image.width]);
+		}
+		m_MipLevels.push_back(std::move(image));
+
+		//Box filter, odd sides repeat their last row or column
+		while (m_MipLevels.back().width > 1 || m_MipLevels.back().height > 1)
+		{
+			const MipLevel& source{ m_MipLevels.back() };
+			MipLevel level{ std::max(1, source.width / 2), std::max(1, source.height / 2) };
+			level.blocksPerRow = level.width;
+			level.pixels.resize(static_cast<size_t>(level.width) * level.height);
+
+			for (int y{}; y < level.height; ++y)
+			{
+				const int sourceRows[2]{ std::min(2 * y, source.height - 1), std::min(2 * y + 1, source.height - 1) };
+				for (int x{}; x < level.width; ++x)
+				{
+					const int sourceColumns[2]{ std::min(2 * x, source.width - 1), std::min(2 * x + 1, source.width - 1) };
+
+					uint32_t texel{};
+					for (int channel{}; channel < 32; channel += 8)
+					{
+						uint32_t sum{ 2 };
+						for (int sourceY : sourceRows)
+						{
+							for (int sourceX : sourceColumns)
+							{
+								sum += (source.pixels[sourceX + sourceY * source.width] >> channel) & 0xFF;
+							}
+						}
+						texel |= (sum / 4) << channel;
+					}
+					level.pixels[x + y * level.width] = texel;
+				}
+			}
+			m_MipLevels.push_back(std::move(level));
+		}
+	}
+
+	void Texture::ApplyLayout()
+	{
+		if (m_Layout == TextureLayout::Linear)
+			return;
+
+		const int blockSize{ m_Layout == TextureLayout::Tiled ? TiledBlockSize : MortonBlockSize };
+		for (MipLevel& level : m_MipLevels)
+		{
+			const int nrBlockRows{ (level.height + blockSize - 1) / blockSize };
+			level.blocksPerRow = (level.width + blockSize - 1) / blockSize;
+
+			//Move every texel to its blocked index, the padding of partial blocks is never addressed
+			const auto reorder{ [&](auto& texels)
+				{
+					if (texels.empty())
+						return;
+
+					std::remove_reference_t<decltype(texels)> blocked(static_cast<size_t>(level.blocksPerRow) * nrBlockRows * blockSize * blockSize);
+					for (int y{}; y < level.height; ++y)
+					{
+						for (int x{}; x < level.width; ++x)
+						{
+							const int index{ m_Layout == TextureLayout::Tiled ?
+								GetTexelIndex<TextureLayout::Tiled>(level, x, y) :
+								GetTexelIndex<TextureLayout::Morton>(level, x, y) };
+							blocked[index] = texels[x + y * level.width];
+						}
+					}
+					texels = std::move(blocked);
+				} };
+			reorder(level.pixels);
+			reorder(level.colors);
+		}
+	}
+
+	TextureFootprint Texture::GetFootprint(const Vector2& uvDdx, const Vector2& uvDdy, TextureFilter filter, int maxAnisotropy) const
+	{
+		//Sides of the pixel footprint measured in texels of the image
+		const float width{ static_cast<float>(m_MipLevels[0].width) };
+		const float height{ static_cast<float>(m_MipLevels[0].height) };
+		const Vector2 texelDdx{ uvDdx.x * width, uvDdx.y * height };
+		const Vector2 texelDdy{ uvDdy.x * width, uvDdy.y * height };
+		const float lengthDdx{ Vector2::Dot(texelDdx, texelDdx) };
+		const float lengthDdy{ Vector2::Dot(texelDdy, texelDdy) };
+		const float major{ std::max(lengthDdx, lengthDdy) };
+		const float maxMipLevel{ static_cast<float>(m_MipLevels.size() - 1) };
+
+		//magnified or a zero footprint is level 0, log2 of 0 is -inf
+		TextureFootprint footprint{};
+		if (!(major > 1.f))
+			return footprint;
+
+		if (filter == TextureFilter::Anisotropic && maxAnisotropy > 1)
+		{
+			//Taps along the major axis, each one covers a square of the minor side so the level drops by log2(nrTaps)
+			const float minor{ std::min(lengthDdx, lengthDdy) };
+			const float ratio{ minor > 0.f ? std::sqrt(major / minor) : static_cast<float>(maxAnisotropy) };
+			footprint.nrTaps = std::clamp(static_cast<int>(std::ceil(ratio)), 1, maxAnisotropy);
+
+			const Vector2& axis{ lengthDdx >= lengthDdy ? uvDdx : uvDdy };
+			footprint.axisU = axis.x;
+			footprint.axisV = axis.y;
+		}
+
+		const float mipLevel{ 0.5f * std::log2(major) - std::log2(static_cast<float>(footprint.nrTaps)) };
+		footprint.mipLevel = std::clamp(mipLevel, 0.f, maxMipLevel);
+		return footprint;
 	}
 
-	ColorRGB Texture::Sample(const Vector2& uv) const
+	//Spreads the 4 bits of v over the even bits of a byte
+	static int SpreadBits(int v)
 	{
-		//TODO
+		v = (v | (v << 2)) & 0x33;
+		v = (v | (v << 1)) & 0x55;
+		return v;
+	}
 
-		const int width =  static_cast<int>( std::clamp(abs(uv.x), 0.f, 1.f) * float(m_pSurface->w));
-		const int height = static_cast<int>(std::clamp(abs(uv.y),0.f,1.f) * float(m_pSurface->h));
+	template<TextureLayout Layout>
+	int Texture::GetTexelIndex(const MipLevel& level, int x, int y)
+	{
+		if constexpr (Layout == TextureLayout::Tiled)
+		{
+			const int block{ (y >> 2) * level.blocksPerRow + (x >> 2) };
+			return (block << 4) | ((y & 3) << 2) | (x & 3);
+		}
+		else if constexpr (Layout == TextureLayout::Morton)
+		{
+			const int block{ (y >> 4) * level.blocksPerRow + (x >> 4) };
+			return (block << 8) | SpreadBits(x & 15) | (SpreadBits(y & 15) << 1);
+		}
+		else
+		{
+			return x + y * level.width;
+		}
+	}
 
+	template<TextureStorage Storage, TextureLayout Layout>
+	__m128 Texture::GetTexel(const MipLevel& level, int x, int y)
+	{
+		const int index{ GetTexelIndex<Layout>(level, x, y) };
+		if constexpr (Storage == TextureStorage::RGBA8)
+		{
+			const uint32_t texel{ level.pixels[index] };
+			return _mm_setr_ps(ByteToFloat[texel & 0xFF], ByteToFloat[(texel >> 8) & 0xFF], ByteToFloat[(texel >> 16) & 0xFF], ByteToFloat[texel >> 24]);
+		}
+		else
+		{
+			return _mm_loadu_ps(&level.colors[index].r);
+		}
+	}
 
-		SDL_Color finalColor{};
+	//All 4 channels at once
+	static __m128 LerpTexel(__m128 texel0, __m128 texel1, float factor)
+	{
+		return _mm_add_ps(texel0, _mm_mul_ps(_mm_sub_ps(texel1, texel0), _mm_set1_ps(factor)));
+	}
+
+	//The addressing clamps with min/max so a lookup never branches
+	template<TextureStorage Storage, TextureLayout Layout>
+	__m128 Texture::SamplePoint(const MipLevel& level, const Vector2& uv)
+	{
+		const int x{ std::min(static_cast<int>(std::clamp(abs(uv.x), 0.f, 1.f) * float(level.width)), level.width - 1) };
+		const int y{ std::min(static_cast<int>(std::clamp(abs(uv.y), 0.f, 1.f) * float(level.height)), level.height - 1) };
+		return GetTexel<Storage, Layout>(level, x, y);
+	}
 
-		SDL_GetRGB(m_pSurfacePixels[width + height * m_pSurface->w], m_pSurface->format,
-			&finalColor.r,
-			&finalColor.g,
-			&finalColor.b);
+	template<TextureStorage Storage, TextureLayout Layout>
+	__m128 Texture::SampleBilinear(const MipLevel& level, const Vector2& uv)
+	{
+		//texel centers sit at half coordinates
+		const float x{ std::clamp(abs(uv.x), 0.f, 1.f) * float(level.width) - 0.5f };
+		const float y{ std::clamp(abs(uv.y), 0.f, 1.f) * float(level.height) - 0.5f };
+		const float left{ std::floor(x) };
+		const float top{ std::floor(y) };
+		const float weightX{ x - left };
+		const float weightY{ y - top };
+
+		const int x0{ std::max(static_cast<int>(left), 0) };
+		const int y0{ std::max(static_cast<int>(top), 0) };
+		const int x1{ std::min(static_cast<int>(left) + 1, level.width - 1) };
+		const int y1{ std::min(static_cast<int>(top) + 1, level.height - 1) };
+
+		const __m128 topColor{ LerpTexel(GetTexel<Storage, Layout>(level, x0, y0), GetTexel<Storage, Layout>(level, x1, y0), weightX) };
+		const __m128 bottomColor{ LerpTexel(GetTexel<Storage, Layout>(level, x0, y1), GetTexel<Storage, Layout>(level, x1, y1), weightX) };
+		return LerpTexel(topColor, bottomColor, weightY);
+	}
+
+	template<TextureStorage Storage, TextureLayout Layout>
+	__m128 Texture::SampleTrilinear(const Vector2& uv, float mipLevel) const
+	{
+		const int finer{ static_cast<int>(mipLevel) };
+		const int coarser{ std::min(finer + 1, static_cast<int>(m_MipLevels.size()) - 1) };
+		const __m128 finerColor{ SampleBilinear<Storage, Layout>(m_MipLevels[finer], uv) };
+		if (coarser == finer)
+			return finerColor;
+		return LerpTexel(finerColor, SampleBilinear<Storage, Layout>(m_MipLevels[coarser], uv), mipLevel - static_cast<float>(finer));
+	}
+
+	template<TextureStorage Storage, TextureLayout Layout>
+	TexelRGBA Texture::SampleFiltered(const Vector2& uv, const TextureFootprint& footprint, TextureFilter filter) const
+	{
+		__m128 color{};
+		switch (filter)
+		{
+		case TextureFilter::Point:
+			color = SamplePoint<Storage, Layout>(m_MipLevels[static_cast<int>(footprint.mipLevel + 0.5f)], uv);
+			break;
+		case TextureFilter::Bilinear:
+			color = SampleBilinear<Storage, Layout>(m_MipLevels[static_cast<int>(footprint.mipLevel + 0.5f)], uv);
+			break;
+		case TextureFilter::Trilinear:
+			color = SampleTrilinear<Storage, Layout>(uv, footprint.mipLevel);
+			break;
+		case TextureFilter::Anisotropic:
+		default:
+		{
+			//Trilinear taps evenly spread over the major axis, centered on uv
+			const float step{ 1.f / static_cast<float>(footprint.nrTaps) };
+			color = _mm_setzero_ps();
+			for (int i{}; i < footprint.nrTaps; ++i)
+			{
+				const float offset{ (static_cast<float>(i) + 0.5f) * step - 0.5f };
+				const Vector2 tapUV{ uv.x + footprint.axisU * offset, uv.y + footprint.axisV * offset };
+				color = _mm_add_ps(color, SampleTrilinear<Storage, Layout>(tapUV, footprint.mipLevel));
+			}
+			color = _mm_mul_ps(color, _mm_set1_ps(step));
+			break;
+		}
+		}
+
+		TexelRGBA texel{};
+		_mm_storeu_ps(&texel.r, color);
+		return texel;
+	}
+
+	TexelRGBA Texture::SampleRGBA(const Vector2& uv, const TextureFootprint& footprint, TextureFilter filter) const
+	{
+		return (this->*m_SampleFunction)(uv, footprint, filter);
+	}
+
+	uint32_t Texture::GetPixel(int x, int y) const
+	{
+		const MipLevel& image{ m_MipLevels[0] };
+		int index{};
+		switch (m_Layout)
+		{
+		case TextureLayout::Linear:
+			index = GetTexelIndex<TextureLayout::Linear>(image, x, y);
+			break;
+		case TextureLayout::Tiled:
+			index = GetTexelIndex<TextureLayout::Tiled>(image, x, y);
+			break;
+		case TextureLayout::Morton:
+			index = GetTexelIndex<TextureLayout::Morton>(image, x, y);
+			break;
+		}
 
-		ColorRGB color{ (float)finalColor.r / 255,(float)finalColor.g / 255,(float)finalColor.b / 255 };
-		return (color);
+		if (m_Storage == TextureStorage::RGBA8)
+			return image.pixels[index];
 
+		const TexelRGBA& color{ image.colors[index] };
+		const auto toByte{ [](float channel) { return static_cast<uint32_t>(channel * 255.f + 0.5f); } };
+		return toByte(color.r) | (toByte(color.g) << 8) | (toByte(color.b) << 16) | (toByte(color.a) << 24);
 	}
-}
\ No newline at end of file
+}
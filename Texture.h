@@ -1,28 +1,123 @@
 #pragma once
 #include <SDL_surface.h>
 #include <string>
+#include <vector>
+#include <emmintrin.h>
 #include "ColorRGB.h"
+#include "Vector2.h"
 
 namespace dae
 {
-	struct Vector2;
+	//Software filtering, the mip level is picked from the uv derivatives
+	enum class TextureFilter
+	{
+		Point, //nearest texel of the nearest mip level
+		Bilinear, //2x2 texels of the nearest mip level
+		Trilinear, //bilinear in the two closest mip levels, blended
+		Anisotropic //trilinear taps along the longest axis of the footprint, up to the max anisotropy of them
+	};
+
+	//Part of the texture a pixel covers, textures of the same size can share it
+	struct TextureFootprint
+	{
+		float mipLevel{};
+		//anisotropic filtering averages nrTaps samples over the major axis, a uv offset of one axis long
+		int nrTaps{ 1 };
+		float axisU{};
+		float axisV{};
+	};
+
+	//4 channel result of the software sampler
+	struct TexelRGBA
+	{
+		float r{};
+		float g{};
+		float b{};
+		float a{};
+	};
+
+	//Layout the software sampler reads, the surface is converted to it once at load
+	enum class TextureStorage
+	{
+		RGBA8, //4 bytes per texel, r in the lowest byte, turned into floats through a lookup table
+		Float //TexelRGBA per texel, 4x the memory but a fetch is a plain load
+	};
+
+	//Order of the texels of every mip level in memory for the software sampler, the gpu always gets rows
+	enum class TextureLayout
+	{
+		Linear, //rows
+		Tiled, //4x4 blocks of texels, one 64 byte cache line for RGBA8, blocks in rows
+		Morton //16x16 blocks in rows, Z order inside a block so texels close in u and v are close in memory
+	};
 
 	class Texture
 	{
 	public:
 		~Texture();
 
-		static Texture* LoadFromFile(const std::string& path, ID3D11Device* pDevice);
+		static Texture* LoadFromFile(const std::string& path, ID3D11Device* pDevice,
+			TextureStorage storage = TextureStorage::RGBA8, TextureLayout layout = TextureLayout::Linear);
+		//pSurface has to be SDL_PIXELFORMAT_RGBA32, the texture copies it. Without a device there is no gpu copy and no SRV
+		static Texture* CreateFromSurface(SDL_Surface* pSurface, ID3D11Device* pDevice,
+			TextureStorage storage = TextureStorage::RGBA8, TextureLayout layout = TextureLayout::Linear);
+
 		ID3D11ShaderResourceView* GetSRV() const { return m_pSRV; }
-		ColorRGB Sample(const Vector2& uv) const;
+		//All 4 channels over a footprint from GetFootprint
+		TexelRGBA SampleRGBA(const Vector2& uv, const TextureFootprint& footprint, TextureFilter filter) const;
+		//uvDdx and uvDdy are the screen space derivatives of uv, they describe the footprint of the pixel in the texture
+		TextureFootprint GetFootprint(const Vector2& uvDdx, const Vector2& uvDdy, TextureFilter filter, int maxAnisotropy = 1) const;
+
+		//Texel (x, y) of the image as SDL_PIXELFORMAT_RGBA32, whatever the storage and layout
+		uint32_t GetPixel(int x, int y) const;
+		int GetWidth() const { return m_MipLevels[0].width; }
+		int GetHeight() const { return m_MipLevels[0].height; }
+		int GetNrMipLevels() const { return static_cast<int>(m_MipLevels.size()); }
+		TextureStorage GetStorage() const { return m_Storage; }
+		TextureLayout GetLayout() const { return m_Layout; }
 
 	private:
-		Texture(SDL_Surface* pSurface, ID3D11Device* pDevice);
+		Texture(SDL_Surface* pSurface, ID3D11Device* pDevice, TextureStorage storage, TextureLayout layout);
+
+		//Loads an image converted to SDL_PIXELFORMAT_RGBA32, the caller frees it
+		static SDL_Surface* LoadSurface(const std::string& path);
+
+		//Level 0 is the image, every next level halves both sides down to 1x1
+		//Only the vector of the storage is filled, the RGBA8 one also while uploading to the gpu
+		struct MipLevel
+		{
+			int width{};
+			int height{};
+			int blocksPerRow{}; //blocked layouts are padded to whole blocks
+			std::vector<uint32_t> pixels{};
+			std::vector<TexelRGBA> colors{};
+		};
+
+		using SampleFunction = TexelRGBA(Texture::*)(const Vector2& uv, const TextureFootprint& footprint, TextureFilter filter) const;
 
 		ID3D11ShaderResourceView* m_pSRV{ nullptr };
 		ID3D11Texture2D* m_pResource{ nullptr };
 		ID3D11Device* m_pDevice{ nullptr };
-		SDL_Surface* m_pSurface{ nullptr };
-		uint32_t* m_pSurfacePixels{ nullptr };
+		TextureStorage m_Storage{};
+		TextureLayout m_Layout{};
+		std::vector<MipLevel> m_MipLevels{};
+		SampleFunction m_SampleFunction{ nullptr }; //instance of SampleFiltered for the storage and layout
+
+		void BuildMipLevels(SDL_Surface* pSurface);
+		void ApplyLayout();
+
+		template<TextureLayout Layout>
+		static int GetTexelIndex(const MipLevel& level, int x, int y);
+		//Filtering works on all 4 channels of a texel in one SSE register
+		template<TextureStorage Storage, TextureLayout Layout>
+		static __m128 GetTexel(const MipLevel& level, int x, int y);
+		template<TextureStorage Storage, TextureLayout Layout>
+		static __m128 SamplePoint(const MipLevel& level, const Vector2& uv);
+		template<TextureStorage Storage, TextureLayout Layout>
+		static __m128 SampleBilinear(const MipLevel& level, const Vector2& uv);
+		template<TextureStorage Storage, TextureLayout Layout>
+		__m128 SampleTrilinear(const Vector2& uv, float mipLevel) const;
+		template<TextureStorage Storage, TextureLayout Layout>
+		TexelRGBA SampleFiltered(const Vector2& uv, const TextureFootprint& footprint, TextureFilter filter) const;
 	};
-}
\ No newline at end of file
+}
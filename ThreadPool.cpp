@@ -0,0 +1,102 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+namespace dae
+{
+	ThreadPool::ThreadPool(uint32_t nrThreads)
+	{
+		if (nrThreads == 0)
+		{
+			nrThreads = std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		//worker 0 is the thread calling ParallelFor
+		m_Threads.reserve(nrThreads - 1);
+		for (uint32_t i{ 1 }; i < nrThreads; ++i)
+		{
+			m_Threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_IsQuitting = true;
+		}
+		m_WakeCondition.notify_all();
+
+		for (std::thread& thread : m_Threads)
+		{
+			thread.join();
+		}
+	}
+
+	void ThreadPool::ParallelFor(uint32_t count, const Job& job)
+	{
+		if (count == 0)
+			return;
+
+		if (count == 1 || m_Threads.empty())
+		{
+			for (uint32_t i{}; i < count; ++i)
+			{
+				job(i, 0);
+			}
+			return;
+		}
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_pJob = &job;
+			m_JobCount = count;
+			m_NextIndex.store(0, std::memory_order_relaxed);
+			m_NrBusyThreads = static_cast<uint32_t>(m_Threads.size());
+			++m_Generation;
+		}
+		m_WakeCondition.notify_all();
+
+		RunJobs(0);
+
+		//the job lives on the caller's stack, so wait for every worker to let go of it
+		std::unique_lock lock{ m_Mutex };
+		m_DoneCondition.wait(lock, [this] { return m_NrBusyThreads == 0; });
+		m_pJob = nullptr;
+	}
+
+	void ThreadPool::WorkerLoop(uint32_t workerIndex)
+	{
+		uint64_t seenGeneration{};
+		while (true)
+		{
+			{
+				std::unique_lock lock{ m_Mutex };
+				m_WakeCondition.wait(lock, [&] { return m_IsQuitting || m_Generation != seenGeneration; });
+				if (m_IsQuitting)
+					return;
+				seenGeneration = m_Generation;
+			}
+
+			RunJobs(workerIndex);
+
+			bool isLast{};
+			{
+				std::lock_guard lock{ m_Mutex };
+				isLast = --m_NrBusyThreads == 0;
+			}
+			if (isLast)
+			{
+				m_DoneCondition.notify_one();
+			}
+		}
+	}
+
+	void ThreadPool::RunJobs(uint32_t workerIndex)
+	{
+		const Job& job{ *m_pJob };
+		for (uint32_t i{ m_NextIndex.fetch_add(1, std::memory_order_relaxed) }; i < m_JobCount; i = m_NextIndex.fetch_add(1, std::memory_order_relaxed))
+		{
+			job(i, workerIndex);
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	class ThreadPool final
+	{
+	public:
+		//0 threads = one per hardware thread, the calling thread counts as one of them
+		explicit ThreadPool(uint32_t nrThreads = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		using Job = std::function<void(uint32_t index, uint32_t workerIndex)>;
+
+		/**
+		 * \brief Runs job for every index in [0, count) spread over all workers, blocks until every index is done
+		 * \param count number of jobs
+		 * \param job called with the job index and the index [0, GetNrWorkers()) of the worker running it
+		 */
+		void ParallelFor(uint32_t count, const Job& job);
+
+		uint32_t GetNrWorkers() const { return static_cast<uint32_t>(m_Threads.size()) + 1; }
+
+	private:
+		std::vector<std::thread> m_Threads{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WakeCondition{};
+		std::condition_variable m_DoneCondition{};
+
+		const Job* m_pJob{ nullptr };
+		uint32_t m_JobCount{};
+		uint64_t m_Generation{};
+		uint32_t m_NrBusyThreads{};
+		bool m_IsQuitting{ false };
+
+		std::atomic<uint32_t> m_NextIndex{};
+
+		void WorkerLoop(uint32_t workerIndex);
+		void RunJobs(uint32_t workerIndex);
+	};
+}
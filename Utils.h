@@ -1,124 +1,63 @@
 #pragma once
-#include <fstream>
 #include "Math.h"
 #include <vector>
+#include <unordered_map>
 #include "Mesh.h"
+#include "ObjParser.h"
 
 namespace dae
 {
 	namespace Utils
 	{
-		//Just parses vertices and indices
+		//Just parses vertices and indices, the file is memory mapped and parsed on all cores
 #pragma warning(push)
 #pragma warning(disable : 4505) //Warning unreferenced local function
 		static bool ParseOBJ(const std::string& filename, std::vector<Vertex_PosCol>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding = true)
 		{
-			std::ifstream file(filename);
-			if (!file)
+			ObjData obj{};
+			if (!ParseOBJFile(filename, obj))
 				return false;
 
-			std::vector<Vector3> positions{};
-			std::vector<Vector3> normals{};
-			std::vector<Vector2> UVs{};
-
 			vertices.clear();
 			indices.clear();
 
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
+			//Corners with the same position, uv and normal share one vertex
+			std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> cornerVertices{};
+			cornerVertices.reserve(obj.corners.size());
+			vertices.reserve(obj.corners.size());
+			indices.resize(obj.corners.size());
+			for (size_t i = 0; i < obj.corners.size(); ++i)
 			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
+				const ObjCorner& corner = obj.corners[i];
+				const auto [it, isNew] = cornerVertices.try_emplace(corner, uint32_t(vertices.size()));
+				indices[i] = it->second;
+				if (!isNew)
+					continue;
+
+				Vertex_PosCol vertex{};
+				vertex.Pos = obj.positions[corner.position];
+				if (corner.uv >= 0)
 				{
-					// Ignore Comment
+					const Vector2& uv = obj.uvs[corner.uv];
+					vertex.Uv = Vector2(uv.x, 1 - uv.y);
 				}
-				else if (sCommand == "v")
+				if (corner.normal >= 0)
 				{
-					//Vertex
-					float x, y, z;
-					file >> x >> y >> z;
-
-					positions.emplace_back(x, y, z);
+					vertex.Normal = obj.normals[corner.normal];
 				}
-				else if (sCommand == "vt")
-				{
-					// Vertex TexCoord
-					float u, v;
-					file >> u >> v;
-					UVs.emplace_back(u, 1 - v);
-				}
-				else if (sCommand == "vn")
-				{
-					// Vertex Normal
-					float x, y, z;
-					file >> x >> y >> z;
+				vertices.push_back(vertex);
+			}
+			vertices.shrink_to_fit();
 
-					normals.emplace_back(x, y, z);
-				}
-				else if (sCommand == "f")
+			if (flipAxisAndWinding)
+			{
+				for (size_t i = 0; i < indices.size(); i += 3)
 				{
-					//if a face is read:
-					//construct the 3 vertices, add them to the vertex array
-					//add three indices to the index array
-					//add the material index as attibute to the attribute array
-					//
-					// Faces or triangles
-					Vertex_PosCol vertex{};
-					size_t iPosition, iTexCoord, iNormal;
-
-					uint32_t tempIndices[3];
-					for (size_t iFace = 0; iFace < 3; iFace++)
-					{
-						// OBJ format uses 1-based arrays
-						file >> iPosition;
-						vertex.Pos = positions[iPosition - 1];
-
-						if ('/' == file.peek())//is next in buffer ==  '/' ?
-						{
-							file.ignore();//read and ignore one element ('/')
-
-							if ('/' != file.peek())
-							{
-								// Optional texture coordinate
-								file >> iTexCoord;
-								vertex.Uv = UVs[iTexCoord - 1];
-							}
-
-							if ('/' == file.peek())
-							{
-								file.ignore();
-
-								// Optional vertex normal
-								file >> iNormal;
-								vertex.Normal = normals[iNormal - 1];
-							}
-						}
-
-						vertices.push_back(vertex);
-						tempIndices[iFace] = uint32_t(vertices.size()) - 1;
-						//indices.push_back(uint32_t(vertices.size()) - 1);
-					}
-
-					indices.push_back(tempIndices[0]);
-					if (flipAxisAndWinding)
-					{
-						indices.push_back(tempIndices[2]);
-						indices.push_back(tempIndices[1]);
-					}
-					else
-					{
-						indices.push_back(tempIndices[1]);
-						indices.push_back(tempIndices[2]);
-					}
+					std::swap(indices[i + 1], indices[i + 2]);
 				}
-				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
 			}
 
-			//Cheap Tangent Calculations
+			//Cheap Tangent Calculations, the tangents of all triangles sharing a vertex are summed
 			for (uint32_t i = 0; i < indices.size(); i += 3)
 			{
 				uint32_t index0 = indices[i];
@@ -136,7 +75,11 @@ namespace dae
 				const Vector3 edge1 = p2 - p0;
 				const Vector2 diffX = Vector2(uv1.x - uv0.x, uv2.x - uv0.x);
 				const Vector2 diffY = Vector2(uv1.y - uv0.y, uv2.y - uv0.y);
-				float r = 1.f / Vector2::Cross(diffX, diffY);
+				//Triangles without uv area have no tangent, with shared vertices an infinite one would spoil every neighbour
+				const float uvArea = Vector2::Cross(diffX, diffY);
+				if (std::abs(uvArea) <= FLT_EPSILON * (diffX.SqrMagnitude() + diffY.SqrMagnitude()))
+					continue;
+				float r = 1.f / uvArea;
 
 				Vector3 tangent = (edge0 * diffY.y - edge1 * diffY.x) * r;
 				vertices[index0].Tangent += tangent;
@@ -147,7 +90,14 @@ namespace dae
 			//Create the Tangents (reject)
 			for (auto& v : vertices)
 			{
-				v.Tangent = Vector3::Reject(v.Tangent, v.Normal).Normalized();
+				v.Tangent = Vector3::Reject(v.Tangent, v.Normal);
+				//Only used by triangles without uv area, any tangent perpendicular to the normal will do
+				if (v.Tangent.SqrMagnitude() == 0.f)
+				{
+					const Vector3 axis{ std::abs(v.Normal.x) < 0.9f ? Vector3{ 1.f, 0.f, 0.f } : Vector3{ 0.f, 1.f, 0.f } };
+					v.Tangent = Vector3::Reject(axis, v.Normal);
+				}
+				v.Tangent = v.Tangent.Normalized();
 
 				if (flipAxisAndWinding)
 				{
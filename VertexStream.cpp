@@ -0,0 +1,381 @@
+#include "pch.h"
+#include "VertexStream.h"
+#include "RasterizerSIMD.h"
+#include "Mesh.h"
+
+#include <new>
+#include <immintrin.h>
+
+namespace dae
+{
+	namespace Rasterizer
+	{
+		static constexpr std::align_val_t StreamAlignment{ 32 };
+		static constexpr float MaxCompactValue{ 65535.f };
+
+		VertexStream::~VertexStream()
+		{
+			::operator delete[](m_pOwnedData, StreamAlignment);
+		}
+
+		void VertexStream::SetVertices(const std::vector<Vertex_PosCol>& vertices, VertexFormat format)
+		{
+			::operator delete[](m_pOwnedData, StreamAlignment);
+
+			m_NrVertices = static_cast<uint32_t>(vertices.size());
+			m_Capacity = GetCapacity(m_NrVertices);
+			m_Format = format;
+			m_Quantization = format == VertexFormat::Compact ? GetQuantization(vertices) : VertexQuantization{};
+			m_pOwnedData = ::operator new[](GetStreamSize(m_NrVertices, m_Format), StreamAlignment);
+			WriteStream(vertices, m_Format, m_Quantization, m_pOwnedData);
+			m_pData = m_pOwnedData;
+		}
+
+		void VertexStream::SetStream(const void* pData, uint32_t nrVertices, VertexFormat format, const VertexQuantization& quantization)
+		{
+			::operator delete[](m_pOwnedData, StreamAlignment);
+			m_pOwnedData = nullptr;
+
+			m_NrVertices = nrVertices;
+			m_Capacity = GetCapacity(m_NrVertices);
+			m_Format = format;
+			m_Quantization = quantization;
+			m_pData = pData;
+		}
+
+		size_t VertexStream::GetStreamSize(uint32_t nrVertices, VertexFormat format)
+		{
+			const size_t capacity{ GetCapacity(nrVertices) };
+			return format == VertexFormat::Compact ? capacity * NrCompactStreams * sizeof(uint16_t) : capacity * NrVertexStreams * sizeof(float);
+		}
+
+		VertexQuantization VertexStream::GetQuantization(const std::vector<Vertex_PosCol>& vertices)
+		{
+			VertexQuantization quantization{};
+			if (vertices.empty())
+				return quantization;
+
+			const auto setBounds{ [&](CompactStreamAttribute attribute, auto getValue)
+				{
+					float min{ getValue(vertices.front()) };
+					float max{ min };
+					for (const Vertex_PosCol& vertex : vertices)
+					{
+						min = std::min(min, getValue(vertex));
+						max = std::max(max, getValue(vertex));
+					}
+					quantization.offsets[attribute] = min;
+					quantization.scales[attribute] = (max - min) / MaxCompactValue;
+				} };
+			setBounds(CompactPosX, [](const Vertex_PosCol& v) { return v.Pos.x; });
+			setBounds(CompactPosY, [](const Vertex_PosCol& v) { return v.Pos.y; });
+			setBounds(CompactPosZ, [](const Vertex_PosCol& v) { return v.Pos.z; });
+			setBounds(CompactU, [](const Vertex_PosCol& v) { return v.Uv.x; });
+			setBounds(CompactV, [](const Vertex_PosCol& v) { return v.Uv.y; });
+
+			for (int a{ CompactNormalX }; a <= CompactTangentY; ++a)
+			{
+				quantization.offsets[a] = -1.f;
+				quantization.scales[a] = 2.f / MaxCompactValue;
+			}
+			return quantization;
+		}
+
+		//Unit vector folded onto the octahedron |x| + |y| + |z| = 1, the lower half mirrored over the diagonals, so two values in [-1, 1]
+		static Vector2 EncodeOctahedral(const Vector3& v)
+		{
+			const float length{ std::abs(v.x) + std::abs(v.y) + std::abs(v.z) };
+			if (length == 0.f)
+				return Vector2{};
+
+			const float x{ v.x / length };
+			const float y{ v.y / length };
+			if (v.z >= 0.f)
+				return Vector2{ x, y };
+			return Vector2{ (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f), (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f) };
+		}
+
+		static Vector3 DecodeOctahedral(float x, float y)
+		{
+			const float z{ 1.f - std::abs(x) - std::abs(y) };
+			const float fold{ std::max(-z, 0.f) };
+			x += x >= 0.f ? -fold : fold;
+			y += y >= 0.f ? -fold : fold;
+			return Vector3{ x, y, z }.Normalized();
+		}
+
+		void VertexStream::WriteStream(const std::vector<Vertex_PosCol>& vertices, VertexFormat format, const VertexQuantization& quantization, void* pData)
+		{
+			const uint32_t nrVertices{ static_cast<uint32_t>(vertices.size()) };
+			const uint32_t capacity{ GetCapacity(nrVertices) };
+
+			if (format == VertexFormat::Compact)
+			{
+				uint16_t* pValues{ static_cast<uint16_t*>(pData) };
+				std::fill_n(pValues, size_t(capacity) * NrCompactStreams, uint16_t{});
+
+				const auto quantize{ [&](CompactStreamAttribute attribute, uint32_t i, float value)
+					{
+						const float scale{ quantization.scales[attribute] };
+						const float normalized{ scale > 0.f ? (value - quantization.offsets[attribute]) / scale : 0.f };
+						pValues[size_t(attribute) * capacity + i] = static_cast<uint16_t>(std::clamp(normalized + 0.5f, 0.f, MaxCompactValue));
+					} };
+
+				for (uint32_t i{}; i < nrVertices; ++i)
+				{
+					const Vertex_PosCol& v{ vertices[i] };
+					const Vector2 normal{ EncodeOctahedral(v.Normal) };
+					const Vector2 tangent{ EncodeOctahedral(v.Tangent) };
+					quantize(CompactPosX, i, v.Pos.x);
+					quantize(CompactPosY, i, v.Pos.y);
+					quantize(CompactPosZ, i, v.Pos.z);
+					quantize(CompactU, i, v.Uv.x);
+					quantize(CompactV, i, v.Uv.y);
+					quantize(CompactNormalX, i, normal.x);
+					quantize(CompactNormalY, i, normal.y);
+					quantize(CompactTangentX, i, tangent.x);
+					quantize(CompactTangentY, i, tangent.y);
+				}
+				return;
+			}
+
+			float* pValues{ static_cast<float*>(pData) };
+			std::fill_n(pValues, size_t(capacity) * NrVertexStreams, 0.f);
+
+			float* attributes[NrVertexStreams]{};
+			for (int a{}; a < NrVertexStreams; ++a)
+			{
+				attributes[a] = pValues + size_t(a) * capacity;
+			}
+
+			for (uint32_t i{}; i < nrVertices; ++i)
+			{
+				const Vertex_PosCol& v{ vertices[i] };
+				attributes[StreamPosX][i] = v.Pos.x;
+				attributes[StreamPosY][i] = v.Pos.y;
+				attributes[StreamPosZ][i] = v.Pos.z;
+				attributes[StreamColorR][i] = v.Color.x;
+				attributes[StreamColorG][i] = v.Color.y;
+				attributes[StreamColorB][i] = v.Color.z;
+				attributes[StreamU][i] = v.Uv.x;
+				attributes[StreamV][i] = v.Uv.y;
+				attributes[StreamNormalX][i] = v.Normal.x;
+				attributes[StreamNormalY][i] = v.Normal.y;
+				attributes[StreamNormalZ][i] = v.Normal.z;
+				attributes[StreamTangentX][i] = v.Tangent.x;
+				attributes[StreamTangentY][i] = v.Tangent.y;
+				attributes[StreamTangentZ][i] = v.Tangent.z;
+			}
+		}
+
+		template<VertexFormat Format>
+		static void TransformVerticesScalar(const VertexStream& stream, const VertexTransform& transform, Vertex_PosColOut* pVertices, Vector4* pClipPositions, uint32_t first, uint32_t last)
+		{
+			const float* attributes[NrVertexStreams]{};
+			const uint16_t* compactAttributes[NrCompactStreams]{};
+			if constexpr (Format == VertexFormat::Float)
+			{
+				for (int a{}; a < NrVertexStreams; ++a)
+				{
+					attributes[a] = stream.GetAttribute(static_cast<VertexStreamAttribute>(a));
+				}
+			}
+			else
+			{
+				for (int a{}; a < NrCompactStreams; ++a)
+				{
+					compactAttributes[a] = stream.GetAttribute(static_cast<CompactStreamAttribute>(a));
+				}
+			}
+			const VertexQuantization& quantization{ stream.GetQuantization() };
+
+			for (uint32_t i{ first }; i < last; ++i)
+			{
+				Vector3 position{};
+				Vector3 color{ 1.f, 1.f, 1.f };
+				Vector2 uv{};
+				Vector3 normal{};
+				Vector3 tangent{};
+				if constexpr (Format == VertexFormat::Float)
+				{
+					position = Vector3{ attributes[StreamPosX][i], attributes[StreamPosY][i], attributes[StreamPosZ][i] };
+					color = Vector3{ attributes[StreamColorR][i], attributes[StreamColorG][i], attributes[StreamColorB][i] };
+					uv = Vector2{ attributes[StreamU][i], attributes[StreamV][i] };
+					normal = Vector3{ attributes[StreamNormalX][i], attributes[StreamNormalY][i], attributes[StreamNormalZ][i] };
+					tangent = Vector3{ attributes[StreamTangentX][i], attributes[StreamTangentY][i], attributes[StreamTangentZ][i] };
+				}
+				else
+				{
+					float values[NrCompactStreams]{};
+					for (int a{}; a < NrCompactStreams; ++a)
+					{
+						values[a] = compactAttributes[a][i] * quantization.scales[a] + quantization.offsets[a];
+					}
+					position = Vector3{ values[CompactPosX], values[CompactPosY], values[CompactPosZ] };
+					uv = Vector2{ values[CompactU], values[CompactV] };
+					normal = DecodeOctahedral(values[CompactNormalX], values[CompactNormalY]);
+					tangent = DecodeOctahedral(values[CompactTangentX], values[CompactTangentY]);
+				}
+
+				const Vector4 clipPos{ transform.worldViewProjection.TransformPoint(position.x, position.y, position.z, 1.f) };
+				pClipPositions[i] = clipPos;
+
+				Vertex_PosColOut& v{ pVertices[i] };
+				v.Pos = Vector4{ clipPos.x / clipPos.w, clipPos.y / clipPos.w, clipPos.z / clipPos.w, clipPos.w };
+				v.Pos.x = ((v.Pos.x + 1) / 2) * transform.width;
+				v.Pos.y = ((1 - v.Pos.y) / 2) * transform.height;
+				v.Color = color;
+				v.Uv = uv;
+				v.Normal = transform.world.TransformVector(normal.x, normal.y, normal.z);
+				v.Tangent = transform.world.TransformVector(tangent.x, tangent.y, tangent.z);
+				v.viewDirection = transform.cameraOrigin - Vector3{ clipPos };
+			}
+		}
+
+		//x * m[0][column] + y * m[1][column] + z * m[2][column] (+ m[3][column] for points)
+		static __m256 TransformComponent(const Matrix& m, int column, __m256 x, __m256 y, __m256 z, bool isPoint)
+		{
+			const __m256 translation{ _mm256_set1_ps(isPoint ? m[3][column] : 0.f) };
+			return _mm256_fmadd_ps(x, _mm256_set1_ps(m[0][column]),
+				_mm256_fmadd_ps(y, _mm256_set1_ps(m[1][column]),
+				_mm256_fmadd_ps(z, _mm256_set1_ps(m[2][column]), translation)));
+		}
+
+		//8 values of a Compact attribute as value * scale + offset
+		static __m256 LoadCompact(const VertexStream& stream, CompactStreamAttribute attribute, uint32_t batch)
+		{
+			const __m128i values{ _mm_load_si128(reinterpret_cast<const __m128i*>(stream.GetAttribute(attribute) + batch)) };
+			const VertexQuantization& quantization{ stream.GetQuantization() };
+			return _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(values)),
+				_mm256_set1_ps(quantization.scales[attribute]), _mm256_set1_ps(quantization.offsets[attribute]));
+		}
+
+		//DecodeOctahedral for 8 vectors, the fold moves x and y toward zero by max(-z, 0)
+		static void DecodeOctahedral(__m256 x, __m256 y, __m256& outX, __m256& outY, __m256& outZ)
+		{
+			const __m256 signMask{ _mm256_set1_ps(-0.f) };
+			const __m256 z{ _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(1.f), _mm256_andnot_ps(signMask, x)), _mm256_andnot_ps(signMask, y)) };
+			const __m256 fold{ _mm256_max_ps(_mm256_xor_ps(z, signMask), _mm256_setzero_ps()) };
+			x = _mm256_sub_ps(x, _mm256_or_ps(fold, _mm256_and_ps(x, signMask)));
+			y = _mm256_sub_ps(y, _mm256_or_ps(fold, _mm256_and_ps(y, signMask)));
+
+			const __m256 invLength{ _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_sqrt_ps(_mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z))))) };
+			outX = _mm256_mul_ps(x, invLength);
+			outY = _mm256_mul_ps(y, invLength);
+			outZ = _mm256_mul_ps(z, invLength);
+		}
+
+		template<VertexFormat Format>
+		static void TransformVerticesAVX2(const VertexStream& stream, const VertexTransform& transform, Vertex_PosColOut* pVertices, Vector4* pClipPositions, uint32_t first, uint32_t last)
+		{
+			enum Output : int
+			{
+				ClipX, ClipY, ClipZ, ClipW,
+				ScreenX, ScreenY, ScreenZ,
+				ColorR, ColorG, ColorB,
+				U, V,
+				NormalX, NormalY, NormalZ,
+				TangentX, TangentY, TangentZ,
+				ViewX, ViewY, ViewZ,
+				NrOutputs
+			};
+			alignas(32) float outputs[NrOutputs][VertexBatchSize]{};
+
+			const Matrix& wvp{ transform.worldViewProjection };
+			const Matrix& world{ transform.world };
+			const __m256 one{ _mm256_set1_ps(1.f) };
+			const __m256 halfWidth{ _mm256_set1_ps(transform.width * 0.5f) };
+			const __m256 halfHeight{ _mm256_set1_ps(transform.height * 0.5f) };
+
+			//The stream is padded, so the last batch can always load a whole register
+			for (uint32_t batch{ first }; batch < last; batch += VertexBatchSize)
+			{
+				__m256 px{}, py{}, pz{};
+				__m256 nx{}, ny{}, nz{};
+				__m256 tx{}, ty{}, tz{};
+				if constexpr (Format == VertexFormat::Float)
+				{
+					px = _mm256_load_ps(stream.GetAttribute(StreamPosX) + batch);
+					py = _mm256_load_ps(stream.GetAttribute(StreamPosY) + batch);
+					pz = _mm256_load_ps(stream.GetAttribute(StreamPosZ) + batch);
+					_mm256_store_ps(outputs[ColorR], _mm256_load_ps(stream.GetAttribute(StreamColorR) + batch));
+					_mm256_store_ps(outputs[ColorG], _mm256_load_ps(stream.GetAttribute(StreamColorG) + batch));
+					_mm256_store_ps(outputs[ColorB], _mm256_load_ps(stream.GetAttribute(StreamColorB) + batch));
+					_mm256_store_ps(outputs[U], _mm256_load_ps(stream.GetAttribute(StreamU) + batch));
+					_mm256_store_ps(outputs[V], _mm256_load_ps(stream.GetAttribute(StreamV) + batch));
+					nx = _mm256_load_ps(stream.GetAttribute(StreamNormalX) + batch);
+					ny = _mm256_load_ps(stream.GetAttribute(StreamNormalY) + batch);
+					nz = _mm256_load_ps(stream.GetAttribute(StreamNormalZ) + batch);
+					tx = _mm256_load_ps(stream.GetAttribute(StreamTangentX) + batch);
+					ty = _mm256_load_ps(stream.GetAttribute(StreamTangentY) + batch);
+					tz = _mm256_load_ps(stream.GetAttribute(StreamTangentZ) + batch);
+				}
+				else
+				{
+					px = LoadCompact(stream, CompactPosX, batch);
+					py = LoadCompact(stream, CompactPosY, batch);
+					pz = LoadCompact(stream, CompactPosZ, batch);
+					_mm256_store_ps(outputs[ColorR], one);
+					_mm256_store_ps(outputs[ColorG], one);
+					_mm256_store_ps(outputs[ColorB], one);
+					_mm256_store_ps(outputs[U], LoadCompact(stream, CompactU, batch));
+					_mm256_store_ps(outputs[V], LoadCompact(stream, CompactV, batch));
+					DecodeOctahedral(LoadCompact(stream, CompactNormalX, batch), LoadCompact(stream, CompactNormalY, batch), nx, ny, nz);
+					DecodeOctahedral(LoadCompact(stream, CompactTangentX, batch), LoadCompact(stream, CompactTangentY, batch), tx, ty, tz);
+				}
+
+				const __m256 clipX{ TransformComponent(wvp, 0, px, py, pz, true) };
+				const __m256 clipY{ TransformComponent(wvp, 1, px, py, pz, true) };
+				const __m256 clipZ{ TransformComponent(wvp, 2, px, py, pz, true) };
+				const __m256 clipW{ TransformComponent(wvp, 3, px, py, pz, true) };
+				_mm256_store_ps(outputs[ClipX], clipX);
+				_mm256_store_ps(outputs[ClipY], clipY);
+				_mm256_store_ps(outputs[ClipZ], clipZ);
+				_mm256_store_ps(outputs[ClipW], clipW);
+
+				//Perspective divide and viewport
+				const __m256 ndcX{ _mm256_div_ps(clipX, clipW) };
+				const __m256 ndcY{ _mm256_div_ps(clipY, clipW) };
+				_mm256_store_ps(outputs[ScreenX], _mm256_mul_ps(_mm256_add_ps(ndcX, one), halfWidth));
+				_mm256_store_ps(outputs[ScreenY], _mm256_mul_ps(_mm256_sub_ps(one, ndcY), halfHeight));
+				_mm256_store_ps(outputs[ScreenZ], _mm256_div_ps(clipZ, clipW));
+
+				_mm256_store_ps(outputs[NormalX], TransformComponent(world, 0, nx, ny, nz, false));
+				_mm256_store_ps(outputs[NormalY], TransformComponent(world, 1, nx, ny, nz, false));
+				_mm256_store_ps(outputs[NormalZ], TransformComponent(world, 2, nx, ny, nz, false));
+
+				_mm256_store_ps(outputs[TangentX], TransformComponent(world, 0, tx, ty, tz, false));
+				_mm256_store_ps(outputs[TangentY], TransformComponent(world, 1, tx, ty, tz, false));
+				_mm256_store_ps(outputs[TangentZ], TransformComponent(world, 2, tx, ty, tz, false));
+
+				_mm256_store_ps(outputs[ViewX], _mm256_sub_ps(_mm256_set1_ps(transform.cameraOrigin.x), clipX));
+				_mm256_store_ps(outputs[ViewY], _mm256_sub_ps(_mm256_set1_ps(transform.cameraOrigin.y), clipY));
+				_mm256_store_ps(outputs[ViewZ], _mm256_sub_ps(_mm256_set1_ps(transform.cameraOrigin.z), clipZ));
+
+				//The rest of the pipeline reads whole vertices
+				const uint32_t nrVertices{ std::min(VertexBatchSize, last - batch) };
+				for (uint32_t lane{}; lane < nrVertices; ++lane)
+				{
+					const uint32_t i{ batch + lane };
+					pClipPositions[i] = Vector4{ outputs[ClipX][lane], outputs[ClipY][lane], outputs[ClipZ][lane], outputs[ClipW][lane] };
+
+					Vertex_PosColOut& v{ pVertices[i] };
+					v.Pos = Vector4{ outputs[ScreenX][lane], outputs[ScreenY][lane], outputs[ScreenZ][lane], outputs[ClipW][lane] };
+					v.Color = Vector3{ outputs[ColorR][lane], outputs[ColorG][lane], outputs[ColorB][lane] };
+					v.Uv = Vector2{ outputs[U][lane], outputs[V][lane] };
+					v.Normal = Vector3{ outputs[NormalX][lane], outputs[NormalY][lane], outputs[NormalZ][lane] };
+					v.Tangent = Vector3{ outputs[TangentX][lane], outputs[TangentY][lane], outputs[TangentZ][lane] };
+					v.viewDirection = Vector3{ outputs[ViewX][lane], outputs[ViewY][lane], outputs[ViewZ][lane] };
+				}
+			}
+		}
+
+		VertexTransformFunction GetVertexTransformFunction(VertexFormat format)
+		{
+			static const bool hasAVX2{ HasAVX2() };
+			if (format == VertexFormat::Compact)
+				return hasAVX2 ? TransformVerticesAVX2<VertexFormat::Compact> : TransformVerticesScalar<VertexFormat::Compact>;
+			return hasAVX2 ? TransformVerticesAVX2<VertexFormat::Float> : TransformVerticesScalar<VertexFormat::Float>;
+		}
+	}
+}
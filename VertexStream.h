@@ -0,0 +1,111 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Math.h"
+
+struct Vertex_PosCol;
+struct Vertex_PosColOut;
+
+namespace dae
+{
+	namespace Rasterizer
+	{
+		enum VertexStreamAttribute : int
+		{
+			StreamPosX, StreamPosY, StreamPosZ,
+			StreamColorR, StreamColorG, StreamColorB,
+			StreamU, StreamV,
+			StreamNormalX, StreamNormalY, StreamNormalZ,
+			StreamTangentX, StreamTangentY, StreamTangentZ,
+			NrVertexStreams
+		};
+
+		//Attributes of a Compact stream, the normal and tangent are octahedral so two values each
+		enum CompactStreamAttribute : int
+		{
+			CompactPosX, CompactPosY, CompactPosZ,
+			CompactU, CompactV,
+			CompactNormalX, CompactNormalY,
+			CompactTangentX, CompactTangentY,
+			NrCompactStreams
+		};
+
+		enum class VertexFormat : uint32_t
+		{
+			Float, //56 bytes a vertex
+			Compact //18 bytes a vertex, every attribute 16 bit, the color is always white
+		};
+
+		//A Compact attribute is value * scale + offset, positions and uvs span their bounds, octahedral values [-1, 1]
+		struct VertexQuantization
+		{
+			float scales[NrCompactStreams]{};
+			float offsets[NrCompactStreams]{};
+		};
+
+		//Vertices handled per iteration of the batched vertex transform
+		constexpr uint32_t VertexBatchSize{ 8 };
+
+		//Vertex attributes as separate 32 byte aligned arrays, padded with zeros to a multiple of VertexBatchSize
+		class VertexStream final
+		{
+		public:
+			VertexStream() = default;
+			~VertexStream();
+
+			VertexStream(const VertexStream&) = delete;
+			VertexStream(VertexStream&&) noexcept = delete;
+			VertexStream& operator=(const VertexStream&) = delete;
+			VertexStream& operator=(VertexStream&&) noexcept = delete;
+
+			void SetVertices(const std::vector<Vertex_PosCol>& vertices, VertexFormat format = VertexFormat::Float);
+			//Uses attributes that already have the stream layout without copying them, pData has to outlive the stream
+			void SetStream(const void* pData, uint32_t nrVertices, VertexFormat format = VertexFormat::Float, const VertexQuantization& quantization = {});
+
+			uint32_t GetNrVertices() const { return m_NrVertices; }
+			VertexFormat GetFormat() const { return m_Format; }
+			const VertexQuantization& GetQuantization() const { return m_Quantization; }
+			//Float streams
+			const float* GetAttribute(VertexStreamAttribute attribute) const { return static_cast<const float*>(m_pData) + size_t(attribute) * m_Capacity; }
+			//Compact streams
+			const uint16_t* GetAttribute(CompactStreamAttribute attribute) const { return static_cast<const uint16_t*>(m_pData) + size_t(attribute) * m_Capacity; }
+
+			//Values per attribute for nrVertices
+			static uint32_t GetCapacity(uint32_t nrVertices) { return (nrVertices + VertexBatchSize - 1) / VertexBatchSize * VertexBatchSize; }
+			//Bytes of the stream of nrVertices
+			static size_t GetStreamSize(uint32_t nrVertices, VertexFormat format);
+			//Bounds of the positions and uvs for a Compact stream of vertices
+			static VertexQuantization GetQuantization(const std::vector<Vertex_PosCol>& vertices);
+			//Writes vertices in the stream layout, pData holds GetStreamSize bytes and is 32 byte aligned
+			static void WriteStream(const std::vector<Vertex_PosCol>& vertices, VertexFormat format, const VertexQuantization& quantization, void* pData);
+
+		private:
+			const void* m_pData{ nullptr };
+			void* m_pOwnedData{ nullptr }; //m_pData when the stream made the copy itself
+			uint32_t m_NrVertices{};
+			uint32_t m_Capacity{}; //values per attribute
+			VertexFormat m_Format{ VertexFormat::Float };
+			VertexQuantization m_Quantization{};
+		};
+
+		struct VertexTransform
+		{
+			Matrix worldViewProjection{};
+			Matrix world{};
+			Vector3 cameraOrigin{};
+			float width{};
+			float height{};
+		};
+
+		/**
+		 * \brief Software vertex stage for the vertices [first, last), first has to be a multiple of VertexBatchSize
+		 * \param pVertices receives the position after the perspective divide and viewport mapping, the color and uv
+		 * and the world space normal, tangent and view direction
+		 * \param pClipPositions receives the position before the perspective divide
+		 */
+		using VertexTransformFunction = void(*)(const VertexStream& stream, const VertexTransform& transform, Vertex_PosColOut* pVertices, Vector4* pClipPositions, uint32_t first, uint32_t last);
+
+		//For streams of format, AVX2 when the cpu and os support it, scalar otherwise
+		VertexTransformFunction GetVertexTransformFunction(VertexFormat format);
+	}
+}
@@ -77,6 +77,8 @@ int main(int argc, char* args[])
 					pRenderer->CycleCullMode();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
 					pRenderer->ToggleUniformColor();
+				if (e.key.keysym.scancode == SDL_SCANCODE_V)
+					pRenderer->ToggleVisibilityBuffer();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
 				{
 					HANDLE h = GetStdHandle(STD_OUTPUT_HANDLE);